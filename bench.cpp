@@ -0,0 +1,1310 @@
+#include "snake.h"
+
+using namespace std;
+
+
+bool readFileBytes(const string &path, vector<Uint8> &bytes)
+{
+    ifstream in(path, ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+    bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    return true;
+}
+
+// Decodes every asset with the libraries the game loads them with, so the
+// mixer must already be open in the format the game uses
+bool packAssets(const string &path)
+{
+    const size_t count = sizeof(assetFiles) / sizeof(assetFiles[0]);
+    vector<AssetEntry> entries(count);
+    vector<vector<Uint8>> contents(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const AssetFile &file = assetFiles[i];
+        AssetEntry &entry = entries[i];
+        memset(&entry, 0, sizeof(entry));
+        if (strlen(file.path) >= (size_t)ASSET_NAME_LENGTH)
+        {
+            cout << "Asset path too long for the bundle: " << file.path << endl;
+            return false;
+        }
+        strcpy(entry.name, file.path);
+        entry.type = file.type;
+
+        vector<Uint8> &bytes = contents[i];
+        bool ok = true;
+        if (file.type == ASSET_IMAGE)
+        {
+            SDL_Surface *loaded = IMG_Load(file.path);
+            SDL_Surface *rgba = loaded != nullptr ? SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0) : nullptr;
+            ok = rgba != nullptr;
+            if (ok)
+            {
+                entry.width = rgba->w;
+                entry.height = rgba->h;
+                bytes.resize((size_t)rgba->w * rgba->h * 4);
+                for (int y = 0; y < rgba->h; y++)
+                {
+                    memcpy(&bytes[(size_t)y * rgba->w * 4], (const Uint8 *)rgba->pixels + y * rgba->pitch, rgba->w * 4);
+                }
+            }
+            SDL_FreeSurface(rgba);
+            SDL_FreeSurface(loaded);
+        }
+        else if (file.type == ASSET_SOUND)
+        {
+            Mix_Chunk *chunk = Mix_LoadWAV(file.path);
+            ok = chunk != nullptr;
+            if (ok)
+            {
+                bytes.assign(chunk->abuf, chunk->abuf + chunk->alen);
+            }
+            Mix_FreeChunk(chunk);
+        }
+        else
+        {
+            ok = readFileBytes(file.path, bytes);
+        }
+
+        if (!ok)
+        {
+            cout << "Failed to pack " << file.path << endl;
+            return false;
+        }
+        entry.size = bytes.size();
+    }
+
+    AssetBundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "SNKA", 4);
+    header.version = ASSET_BUNDLE_VERSION;
+    header.count = (Uint32)count;
+    int frequency = 0, channels = 0;
+    Uint16 format = 0;
+    Mix_QuerySpec(&frequency, &format, &channels);
+    header.audioFrequency = frequency;
+    header.audioFormat = format;
+    header.audioChannels = (Uint16)channels;
+
+    auto align = [](Uint64 offset) { return (offset + ASSET_ALIGNMENT - 1) & ~(Uint64)(ASSET_ALIGNMENT - 1); };
+    Uint64 offset = align(sizeof(header) + count * sizeof(AssetEntry));
+    for (AssetEntry &entry : entries)
+    {
+        entry.offset = offset;
+        offset = align(offset + entry.size);
+    }
+    header.fileSize = offset;
+
+    ofstream out(path, ios::binary);
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)entries.data(), count * sizeof(AssetEntry));
+    const char padding[ASSET_ALIGNMENT] = {};
+    Uint64 written = sizeof(header) + count * sizeof(AssetEntry);
+    for (size_t i = 0; i < count; i++)
+    {
+        out.write(padding, entries[i].offset - written);
+        out.write((const char *)contents[i].data(), contents[i].size());
+        written = entries[i].offset + entries[i].size;
+    }
+    out.write(padding, header.fileSize - written);
+    if (!out)
+    {
+        cout << "Failed to write asset bundle " << path << endl;
+        return false;
+    }
+
+    cout << "Packed " << count << " assets into " << path << " (" << header.fileSize / 1024 << " KiB)" << endl;
+    return true;
+}
+
+struct BenchResult
+{
+    string name;
+    string layout;
+    int length;
+    int foodEvery;
+    long iterations;
+    double meanNs;
+    double minNs;
+    long pixels; // pixels written per op, 0 when not a fill benchmark
+};
+
+// A snake walking a Hamiltonian cycle over the playfield never dies, so a
+// fixture of any length (up to one short of the full board) can be ticked
+// forever with identical work per tick.
+struct BenchFixture
+{
+    GameState game;
+    vector<SnakeSegment> cycle;
+    size_t head;
+    int foodEvery;
+};
+
+struct BenchLayout
+{
+    const char *name;
+    const Level *level;
+};
+
+vector<SnakeSegment> buildBoardCycle()
+{
+    const int cols = (SCREEN_WIDTH - WALL_THICKNESS * 2) / SNAKE_VELOCITY;
+    const int rows = (SCREEN_HEIGHT - WALL_THICKNESS * 2) / SNAKE_VELOCITY;
+
+    // Row 0 left to right, rows 1..rows-1 serpentine over columns 1..cols-1,
+    // then back up column 0. Closes because rows is even.
+    vector<SnakeSegment> cells;
+    cells.reserve(cols * rows);
+    for (int c = 0; c < cols; c++)
+    {
+        cells.push_back({c, 0});
+    }
+    for (int r = 1; r < rows; r++)
+    {
+        if (r % 2 == 1)
+        {
+            for (int c = cols - 1; c >= 1; c--)
+                cells.push_back({c, r});
+        }
+        else
+        {
+            for (int c = 1; c < cols; c++)
+                cells.push_back({c, r});
+        }
+    }
+    for (int r = rows - 1; r >= 1; r--)
+    {
+        cells.push_back({0, r});
+    }
+
+    for (SnakeSegment &cell : cells)
+    {
+        cell.x = cell.x * SNAKE_VELOCITY + WALL_THICKNESS;
+        cell.y = cell.y * SNAKE_VELOCITY + WALL_THICKNESS;
+    }
+    return cells;
+}
+
+void placeBenchFood(BenchFixture &fixture)
+{
+    if (fixture.foodEvery == 0)
+    {
+        fixture.game.food.x = -SCREEN_WIDTH;
+        fixture.game.food.y = -SCREEN_HEIGHT;
+        return;
+    }
+
+    const SnakeSegment &cell = fixture.cycle[(fixture.head + fixture.foodEvery) % fixture.cycle.size()];
+    fixture.game.food.x = cell.x;
+    fixture.game.food.y = cell.y;
+}
+
+void setupBenchFixture(BenchFixture &fixture, int length, int foodEvery, const BenchLayout &layout)
+{
+    resetGame(fixture.game, *layout.level, 1234, RULES_CLASSIC);
+    fixture.foodEvery = foodEvery;
+
+    size_t n = fixture.cycle.size();
+    fixture.head = length - 1;
+    fixture.game.snake.clear();
+    fixture.game.snake.reserve(n + 1);
+    for (int i = 0; i < length; i++)
+    {
+        fixture.game.snake.pushTail(fixture.cycle[(fixture.head + n - i) % n]);
+    }
+    placeBenchFood(fixture);
+}
+
+TickResult advanceBenchFixture(BenchFixture &fixture)
+{
+    const SnakeSegment &head = fixture.game.snake[0];
+    const SnakeSegment &next = fixture.cycle[(fixture.head + 1) % fixture.cycle.size()];
+    fixture.game.dirX = (next.x - head.x) / SNAKE_VELOCITY;
+    fixture.game.dirY = (next.y - head.y) / SNAKE_VELOCITY;
+
+    TickResult result = tickGame(fixture.game);
+    fixture.head++;
+
+    if (result.ateFood)
+    {
+        // Keep the fixture length constant so every batch does the same work
+        fixture.game.snake.popTail();
+        placeBenchFood(fixture);
+    }
+    return result;
+}
+
+template <typename Body>
+void runBenchmark(vector<BenchResult> &results, const char *name, const char *layout, int length, int foodEvery,
+                  long iterations, Body body, long pixels = 0)
+{
+    const int batches = 5;
+    double freq = (double)SDL_GetPerformanceFrequency();
+    double totalNs = 0, minNs = 0;
+
+    body(); // warm-up
+    for (int b = 0; b < batches; b++)
+    {
+        Uint64 start = SDL_GetPerformanceCounter();
+        for (long i = 0; i < iterations; i++)
+        {
+            body();
+        }
+        double ns = (SDL_GetPerformanceCounter() - start) * 1e9 / freq / iterations;
+        totalNs += ns;
+        minNs = (b == 0) ? ns : min(minNs, ns);
+    }
+
+    results.push_back({name, layout, length, foodEvery, iterations * batches, totalNs / batches, minNs, pixels});
+    cout << name << " layout=" << layout << " length=" << length << " foodEvery=" << foodEvery
+         << ": " << totalNs / batches << " ns";
+    if (pixels > 0)
+    {
+        cout << " (" << pixels * 1000.0 / (totalNs / batches) << " Mpixel/s)";
+    }
+    cout << endl;
+}
+
+// xorshift32, for benchmark inputs that are the same on every run
+Uint32 benchRandom(Uint32 &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// What renderer has been measuring: "raster" or the SDL_Renderer's name
+string rendererName(SDL_Renderer *renderer)
+{
+    SDL_RendererInfo info;
+    if (renderBackend == BACKEND_RASTER || SDL_GetRendererInfo(renderer, &info) != 0)
+    {
+        return renderBackend == BACKEND_RASTER ? "raster" : "unknown";
+    }
+    return info.name;
+}
+
+const char *videoDriverName()
+{
+    const char *driver = SDL_GetCurrentVideoDriver();
+    return driver != nullptr ? driver : "none";
+}
+
+bool writeBenchResults(const vector<BenchResult> &results, SDL_Renderer *renderer, const char *outputPath)
+{
+    ofstream out(outputPath);
+    if (!out)
+    {
+        cout << "Failed to open benchmark output " << outputPath << endl;
+        return false;
+    }
+
+    out << "{\n  \"suite\": \"snake\",\n  \"version\": 1,\n  \"renderer\": \"" << rendererName(renderer)
+        << "\",\n  \"video_driver\": \"" << videoDriverName() << "\",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult &r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"layout\": \"" << r.layout << "\", \"length\": " << r.length
+            << ", \"food_every\": " << r.foodEvery << ", \"iterations\": " << r.iterations
+            << ", \"mean_ns\": " << fixed << setprecision(1) << r.meanNs << ", \"min_ns\": " << r.minNs
+            << ", \"pixels\": " << r.pixels << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return true;
+}
+
+// Pixel throughput of the raster backend's primitives, on a private
+// framebuffer so it runs whichever backend the game uses.
+void runRasterBenchmarks(vector<BenchResult> &results)
+{
+    Framebuffer fb;
+    resizeFramebuffer(fb, SCREEN_WIDTH, SCREEN_HEIGHT);
+    const long screenPixels = (long)SCREEN_WIDTH * SCREEN_HEIGHT;
+
+    // 64x64 sprite covering the whole alpha range, like an antialiased fruit edge
+    SDL_Surface *sprite = SDL_CreateRGBSurfaceWithFormat(0, 64, 64, 32, SDL_PIXELFORMAT_RGBA32);
+    for (int y = 0; y < sprite->h; y++)
+    {
+        Uint32 *row = (Uint32 *)((Uint8 *)sprite->pixels + y * sprite->pitch);
+        for (int x = 0; x < sprite->w; x++)
+        {
+            row[x] = ((Uint32)((x * 4 + y) & 0xFF) << 24) | ((Uint32)(y * 4) << 16) | ((Uint32)(x * 4) << 8) | 0x40;
+        }
+    }
+
+    runBenchmark(results, "raster_fill", "screen", 1, 0, 200,
+                 [&]() { rasterFillRect(fb, {0, 0, fb.width, fb.height}, 0xFFC89664); }, screenPixels);
+
+    const int radius = SNAKE_VELOCITY / 2 + 2;
+    long circlePixels = 0;
+    for (int dy = -radius + 1; dy <= radius; dy++)
+        for (int dx = -radius + 1; dx <= radius; dx++)
+            circlePixels += (dx * dx + dy * dy <= radius * radius);
+    runBenchmark(results, "raster_circle", "segment", 1, 0, 200000,
+                 [&]() { rasterFillCircle(fb, 400, 300, radius, 0xFF00C800); }, circlePixels);
+
+    SDL_Rect spriteRect = {100, 100, sprite->w, sprite->h};
+    runBenchmark(results, "raster_blend", "sprite", 1, 0, 20000,
+                 [&]() { rasterBlit(fb, sprite, &spriteRect); }, (long)sprite->w * sprite->h);
+
+    runBenchmark(results, "raster_blend_scaled", "screen", 1, 0, 100,
+                 [&]() { rasterBlit(fb, sprite, nullptr); }, screenPixels);
+
+    SDL_FreeSurface(sprite);
+}
+
+// Particle update and draw cost at pool sizes up to a full-board death
+// explosion; length is the number of live particles.
+void runParticleBenchmarks(vector<BenchResult> &results, SDL_Renderer *renderer, const Level &level)
+{
+    const int counts[] = {1024, 16384, PARTICLE_CAPACITY};
+    for (int count : counts)
+    {
+        // Long lives keep the pool at count for the whole run
+        clearParticles(particles);
+        emitParticles(particles, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, count, 0, 200, 1e6f, deathPalette,
+                      sizeof(deathPalette) / sizeof(deathPalette[0]));
+
+        long iterations = max(1, (1 << 22) / count);
+        runBenchmark(results, "particles_update", "burst", count, 0, iterations,
+                     [&]() { updateParticles(particles, 1e-4f); });
+        runBenchmark(results, "particles_render", "burst", count, 0, max(1L, iterations / 32),
+                     [&]() { renderParticles(renderer, particles); });
+    }
+
+    BenchFixture fixture;
+    fixture.cycle = buildBoardCycle();
+    BenchLayout layout = {"classic", &level};
+    setupBenchFixture(fixture, (int)fixture.cycle.size() - 1, 0, layout);
+    TickResult death = {COLLISION_SELF, false, false, false, POWER_NONE, false, false};
+    runBenchmark(results, "particles_emit_death", "classic", (int)fixture.game.snake.size(), 0, 20, [&]() {
+        clearParticles(particles);
+        emitTickEffects(particles, fixture.game, death);
+    });
+    clearParticles(particles);
+}
+
+// Frame cost of the spectator wall (ticks, quads and submission), then a
+// search for the most games it still draws at 60 fps: the count doubles until
+// a frame misses, then bisects. length is the number of games. Snakes get a
+// simulated minute of play first so they are not all one segment long.
+void runSpectatorBenchmarks(vector<BenchResult> &results, SDL_Renderer *renderer, const Level &level)
+{
+    SpectatorWall wall;
+    const vector<const char *> live;
+    auto setup = [&](int count) {
+        destroySpectatorWall(wall);
+        setupSpectatorWall(wall, renderer, count, level, live);
+        for (int i = 0; i < 3600; i++)
+        {
+            advanceSpectatorWall(wall, SPECTATOR_FRAME_MS);
+        }
+    };
+    auto frame = [&]() {
+        advanceSpectatorWall(wall, SPECTATOR_FRAME_MS);
+        renderSpectatorWall(renderer, wall);
+        presentFrame(renderer);
+    };
+
+    int width, height;
+    spectatorWallSize(renderer, width, height);
+    const int capacity = spectatorCapacity(width, height);
+
+    int fastest = 0, slowest = 0; // most games within a frame, fewest beyond it
+    for (int count = 16; slowest == 0 && fastest < capacity; count = min(count * 2, capacity))
+    {
+        setup(count);
+        runBenchmark(results, "spectate_frame", "classic", count, 0, 12, frame);
+        (results.back().meanNs <= SPECTATOR_FRAME_MS * 1e6 ? fastest : slowest) = count;
+    }
+
+    // Bisect to within about 5% between the last size that fit and the first that did not
+    while (slowest != 0 && slowest - fastest > max(1, fastest / 20))
+    {
+        int count = (fastest + slowest) / 2;
+        setup(count);
+        frame();
+        Uint64 start = SDL_GetPerformanceCounter();
+        const int frames = 30;
+        for (int i = 0; i < frames; i++)
+        {
+            frame();
+        }
+        double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() / frames;
+        (ms <= SPECTATOR_FRAME_MS ? fastest : slowest) = count;
+    }
+
+    if (fastest > 0 && slowest != 0)
+    {
+        setup(fastest);
+        runBenchmark(results, "spectate_max_60fps", "classic", fastest, 0, 12, frame);
+    }
+    cout << "Spectator wall: " << fastest << " games at 60 fps"
+         << (slowest == 0 ? " (every viewport the wall fits)" : "") << " on the " << rendererName(renderer)
+         << " renderer, " << videoDriverName() << " video driver" << endl;
+    destroySpectatorWall(wall);
+}
+
+// A size x size cell maze: a border, a wall with one gap every fourth row
+// and an obstacle every 64 cells in between.
+LevelSource buildBenchMaze(int size)
+{
+    LevelSource maze;
+    maze.name = "maze";
+    maze.width = maze.height = size * SNAKE_VELOCITY;
+    maze.map.assign(size, string(size, '.'));
+    for (int row = 0; row < size; row++)
+    {
+        string &line = maze.map[row];
+        if (row == 0 || row == size - 1 || row % 4 == 0)
+        {
+            line.assign(size, '#');
+            if (row != 0 && row != size - 1)
+            {
+                line[1 + row * 7919 % (size - 2)] = '.';
+            }
+            continue;
+        }
+        line[0] = line[size - 1] = '#';
+        for (int col = 32 + row % 32; col < size - 1; col += 64)
+        {
+            line[col] = 'X';
+        }
+    }
+    maze.map[1][1] = '@';
+    return maze;
+}
+
+// Compile and load cost per level for mazes up to 4096x4096 cells; length
+// is the side in cells. Loading maps the file and reads one cell, which is
+// all the game does before its first frame. Reading the whole file instead
+// is measured alongside for comparison.
+void runLevelBenchmarks(vector<BenchResult> &results, const string &scratchPath)
+{
+    const int sizes[] = {64, 256, 1024, 4096};
+    for (int size : sizes)
+    {
+        LevelSource maze = buildBenchMaze(size);
+        long iterations = max(1L, (1L << 20) / ((long)size * size));
+        vector<Uint64> image;
+        runBenchmark(results, "level_compile", "maze", size, 0, iterations, [&]() { compileLevel(maze, image); });
+        if (!writeLevel(image, scratchPath))
+        {
+            return;
+        }
+
+        runBenchmark(results, "level_load_read", "maze", size, 0, iterations, [&]() {
+            ifstream in(scratchPath, ios::binary);
+            vector<Uint64> data(image.size());
+            in.read((char *)data.data(), data.size() * 8);
+            Level level;
+            volatile bool hit = bindLevel(level, (const Uint8 *)data.data(), data.size() * 8, scratchPath) &&
+                                hitsWall(level, {SNAKE_VELOCITY, SNAKE_VELOCITY});
+            (void)hit;
+        });
+
+        runBenchmark(results, "level_load_mmap", "maze", size, 0, 200, [&]() {
+            Level level;
+            volatile bool hit = mapLevel(level, scratchPath) && hitsWall(level, {SNAKE_VELOCITY, SNAKE_VELOCITY});
+            (void)hit;
+            freeLevel(level);
+        });
+    }
+    remove(scratchPath.c_str());
+}
+
+// Timer wheel with a steady population: every timer that fires is
+// rescheduled 1..4096 ticks ahead, so the length field (the number of
+// timers) stays constant and the figure is the cost of one tick.
+void runTimerBenchmarks(vector<BenchResult> &results)
+{
+    const int counts[] = {16, 1024, 16384, 131072};
+    for (int count : counts)
+    {
+        TimerWheel wheel;
+        clearTimers(wheel);
+        Uint32 state = 0x2545F491;
+        auto nextDelay = [&]() { return 1 + benchRandom(state) % 4096; };
+        for (int i = 0; i < count; i++)
+        {
+            scheduleTimer(wheel, nextDelay(), TIMER_BONUS_EXPIRE);
+        }
+
+        long iterations = max(1000L, 4000000L / count);
+        runBenchmark(results, "timer_tick", "wheel", count, 0, iterations, [&]() {
+            advanceTimers(wheel, [&](const Timer &timer) { scheduleTimer(wheel, nextDelay(), (TimerKind)timer.kind); });
+        });
+        runBenchmark(results, "timer_schedule_cancel", "wheel", count, 0, 200000,
+                     [&]() { cancelTimer(wheel, scheduleTimer(wheel, nextDelay(), TIMER_BONUS_EXPIRE)); });
+    }
+}
+
+// Batched environment steps. Actions are drawn up front (mostly straight
+// ahead, a turn one step in eight) so only stepping is timed; the length
+// field is the batch size and the figure to watch is env-steps per second.
+void runEnvBenchmarks(vector<BenchResult> &results, const Level &level)
+{
+    struct EnvConfig
+    {
+        int count, threads;
+    };
+    vector<EnvConfig> configs = {{1, 1}, {64, 1}, {1024, 1}, {4096, 1}};
+    int hardwareThreads = (int)std::thread::hardware_concurrency();
+    if (hardwareThreads > 1)
+    {
+        configs.push_back({4096, hardwareThreads});
+    }
+
+    for (const EnvConfig &config : configs)
+    {
+        const int steps = 64;
+        vector<Uint8> actions((size_t)config.count * steps);
+        Uint32 state = 0x2545F491;
+        for (Uint8 &action : actions)
+        {
+            Uint32 r = benchRandom(state);
+            action = r % 8 == 0 ? (Uint8)(ENV_UP + (r >> 8) % 4) : (Uint8)ENV_KEEP;
+        }
+
+        EnvBatch batch;
+        vector<Uint8> observations((size_t)config.count * ENV_PLANES * level.header->cols * level.header->rows);
+        vector<float> rewards(config.count);
+        vector<Uint8> dones(config.count);
+        if (!createEnvBatch(batch, level, config.count, 1, RULES_ALL, config.threads, observations.data(),
+                            rewards.data(), dones.data()))
+        {
+            return;
+        }
+
+        string name = "env_step_threads" + to_string(config.threads);
+        long iterations = max(64L, 200000L / config.count);
+        long step = 0;
+        runBenchmark(results, name.c_str(), "classic", config.count, 0, iterations, [&]() {
+            stepEnvBatch(batch, actions.data() + (step++ % steps) * config.count);
+        });
+        cout << "  " << config.count * 1000.0 / results.back().meanNs << " M env-steps/s" << endl;
+        destroyEnvBatch(batch);
+    }
+}
+
+// Cost of an event on the emitting thread, with the flush thread draining
+// to a scratch file in the background. A batch fits the ring, so nothing is
+// dropped and every iteration takes the full path.
+void runTelemetryBenchmarks(vector<BenchResult> &results, const string &scratchPath)
+{
+    runBenchmark(results, "telemetry_emit_off", "none", 1, 0, 100000,
+                 [&]() { emitTelemetry(TELEMETRY_TICK, 1, 0); });
+
+    if (!startTelemetry(scratchPath.c_str(), 64LL << 20))
+    {
+        return;
+    }
+    runBenchmark(results, "telemetry_emit", "binary", 1, 0, TelemetryRing::CAPACITY / 8,
+                 [&]() { emitTelemetry(TELEMETRY_TICK, 1, 0); });
+    stopTelemetry();
+    remove(scratchPath.c_str());
+}
+
+// Headless benchmark suite. main() selects the dummy video driver and the
+// software renderer before initializeSDL, so this runs on machines without
+// a display or GPU. Results go to outputPath as JSON.
+bool runBenchmarks(SDL_Renderer *renderer, const char *outputPath)
+{
+    // Both layouts come from the classic source, compiled in memory so the
+    // suite does not depend on what is in the level directory
+    LevelSource classicSource;
+    if (!parseLevelSource(classicSource, levelsDirectory + "/classic.lvl"))
+    {
+        return false;
+    }
+    LevelSource openSource = classicSource;
+    openSource.obstacles.clear();
+    Level classicLevel, openLevel;
+    if (!buildLevel(classicLevel, classicSource) || !buildLevel(openLevel, openSource))
+    {
+        return false;
+    }
+
+    vector<BenchResult> results;
+    BenchFixture fixture;
+    fixture.cycle = buildBoardCycle();
+
+    const int fullBoard = (int)fixture.cycle.size() - 1;
+    const int lengths[] = {1, 16, 256, 1024, fullBoard};
+    const int foodEvery[] = {0, 16, 1};
+    const BenchLayout layouts[] = {{"open", &openLevel}, {"classic", &classicLevel}};
+
+    for (const BenchLayout &layout : layouts)
+    {
+        for (int length : lengths)
+        {
+            for (int every : foodEvery)
+            {
+                setupBenchFixture(fixture, length, every, layout);
+                runBenchmark(results, "tick", layout.name, length, every, 20000,
+                             [&]() { advanceBenchFixture(fixture); });
+            }
+
+            setupBenchFixture(fixture, length, 0, layout);
+            runBenchmark(results, "collision", layout.name, length, 0, 20000, [&]() {
+                const SnakeSegment &next = fixture.cycle[(fixture.head + 1) % fixture.cycle.size()];
+                volatile bool hit = hitsWall(*fixture.game.level, next) || hitsSelf(fixture.game.snake, next) || hitsObstacle(fixture.game, next);
+                (void)hit;
+            });
+        }
+    }
+
+    setupBenchFixture(fixture, 1, 0, layouts[1]);
+    runBenchmark(results, "spawn", "classic", 1, 0, 100000, [&]() {
+        spawnFood(fixture.game);
+        spawnBonusFood(fixture.game);
+    });
+
+    for (int length : lengths)
+    {
+        long iterations = max(1, 2000 / length);
+        setupBenchFixture(fixture, length, 0, layouts[1]);
+        runBenchmark(results, "render_body", "classic", length, 0, iterations,
+                     [&]() { renderSnake(renderer, fixture.game.snake); });
+        runBenchmark(results, "frame", "classic", length, 0, iterations, [&]() {
+            renderGame(renderer, fixture.game);
+            presentFrame(renderer);
+        });
+    }
+
+    // Incremental frames need the snake to move, so these tick as well; the
+    // pixel figure is the average repainted per frame
+    for (int length : lengths)
+    {
+        long iterations = max(1, 2000 / length);
+        setupBenchFixture(fixture, length, 16, layouts[1]);
+        dirty.valid = false;
+        long long pixelsBefore = dirty.pixels;
+        long framesBefore = dirty.frames;
+        for (int i = 0; i < 64; i++)
+        {
+            advanceBenchFixture(fixture);
+            renderGameDirty(renderer, fixture.game);
+        }
+        long pixels = (long)((dirty.pixels - pixelsBefore) / (dirty.frames - framesBefore));
+        runBenchmark(results, "frame_dirty", "classic", length, 16, iterations, [&]() {
+            advanceBenchFixture(fixture);
+            renderGameDirty(renderer, fixture.game);
+            presentFrame(renderer);
+        }, pixels);
+    }
+
+    SDL_Color black = {0, 0, 0, 255};
+    runBenchmark(results, "render_hud", "classic", 1, 0, 2000,
+                 [&]() { scoreRenderText(renderer, "Score: 12345", 1, 1, black); });
+
+    runRasterBenchmarks(results);
+    runParticleBenchmarks(results, renderer, classicLevel);
+    runSpectatorBenchmarks(results, renderer, classicLevel);
+    runLevelBenchmarks(results, string(outputPath) + ".level");
+    runTimerBenchmarks(results);
+    runEnvBenchmarks(results, classicLevel);
+    runTelemetryBenchmarks(results, string(outputPath) + ".telemetry");
+
+    return writeBenchResults(results, renderer, outputPath);
+}
+
+// Golden references are run-length encoded TGA (image type 10, 32 bits,
+// top-left origin). The frames are mostly flat colour, so they come out a
+// small fraction of their raw size and still open in any image viewer.
+// Packets stay within a row, as the format asks.
+const int TGA_MAX_PACKET = 128;
+
+void appendTgaPixel(vector<Uint8> &data, Uint32 pixel)
+{
+    const Uint8 *rgba = (const Uint8 *)&pixel;
+    data.insert(data.end(), {rgba[2], rgba[1], rgba[0], rgba[3]});
+}
+
+bool writeFrameTga(const Framebuffer &fb, const string &path)
+{
+    vector<Uint8> data = {0, 0, 10, 0, 0, 0, 0, 0, 0, 0, 0, 0, (Uint8)fb.width, (Uint8)(fb.width >> 8),
+                          (Uint8)fb.height, (Uint8)(fb.height >> 8), 32, 0x28};
+    for (int y = 0; y < fb.height; y++)
+    {
+        const Uint32 *row = fb.pixels.data() + (size_t)y * fb.width;
+        int x = 0;
+        while (x < fb.width)
+        {
+            int run = 1;
+            while (x + run < fb.width && run < TGA_MAX_PACKET && row[x + run] == row[x])
+            {
+                run++;
+            }
+            if (run > 1)
+            {
+                data.push_back((Uint8)(0x80 | (run - 1)));
+                appendTgaPixel(data, row[x]);
+                x += run;
+                continue;
+            }
+
+            // Raw packet, up to where the next run starts
+            int count = 1;
+            while (x + count < fb.width && count < TGA_MAX_PACKET &&
+                   (x + count + 1 == fb.width || row[x + count] != row[x + count + 1]))
+            {
+                count++;
+            }
+            data.push_back((Uint8)(count - 1));
+            for (int k = 0; k < count; k++)
+            {
+                appendTgaPixel(data, row[x + k]);
+            }
+            x += count;
+        }
+    }
+
+    ofstream out(path, ios::binary);
+    out.write((const char *)data.data(), data.size());
+    return (bool)out;
+}
+
+// Reads only what writeFrameTga writes
+bool readFrameTga(vector<Uint32> &pixels, int &width, int &height, const string &path)
+{
+    vector<Uint8> data;
+    if (!readFileBytes(path, data) || data.size() < 18 || data[2] != 10 || data[16] != 32 || (data[17] & 0x20) == 0)
+    {
+        return false;
+    }
+    width = data[12] | data[13] << 8;
+    height = data[14] | data[15] << 8;
+
+    pixels.assign((size_t)width * height, 0);
+    size_t at = 18 + data[0];
+    size_t filled = 0;
+    while (filled < pixels.size())
+    {
+        if (at >= data.size())
+        {
+            return false;
+        }
+        Uint8 packet = data[at++];
+        bool run = (packet & 0x80) != 0;
+        size_t count = min((size_t)(packet & 0x7F) + 1, pixels.size() - filled);
+        size_t bytes = (run ? 1 : count) * 4;
+        if (at + bytes > data.size())
+        {
+            return false;
+        }
+        for (size_t k = 0; k < count; k++)
+        {
+            const Uint8 *bgra = &data[at + (run ? 0 : k * 4)];
+            const Uint8 rgba[4] = {bgra[2], bgra[1], bgra[0], bgra[3]};
+            memcpy(&pixels[filled++], rgba, 4);
+        }
+        at += bytes;
+    }
+    return true;
+}
+
+// Replaces a loaded picture with a checkerboard in two colours, standing in
+// for the decoded PNG in golden frames
+bool makeStandInImage(Image &image, int width, int height, Uint32 even, Uint32 odd)
+{
+    freeImage(image);
+    image.surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+    if (image.surface == nullptr)
+    {
+        return false;
+    }
+    for (int y = 0; y < height; y++)
+    {
+        Uint32 *row = (Uint32 *)((Uint8 *)image.surface->pixels + (size_t)y * image.surface->pitch);
+        for (int x = 0; x < width; x++)
+        {
+            row[x] = (x / 4 + y / 4) % 2 == 0 ? even : odd;
+        }
+    }
+    return true;
+}
+
+// Renders a fixed set of deterministic frames with the raster backend and
+// compares them pixel-for-pixel against <dir>/<name>.tga. Text and pictures
+// are drawn from fixed stand-ins, so the references hold on any FreeType or
+// libpng build. A missing reference is a failure; update rewrites them all.
+// Mismatches are written next to the references as <name>.actual.tga.
+bool runGoldenFrames(SDL_Renderer *renderer, const char *dir, bool update)
+{
+    LevelSource classicSource;
+    Level classicLevel;
+    if (!parseLevelSource(classicSource, levelsDirectory + "/classic.lvl") || !buildLevel(classicLevel, classicSource))
+    {
+        return false;
+    }
+
+    error_code created;
+    if (update && (filesystem::create_directories(dir, created), created))
+    {
+        cout << "Could not create " << dir << ": " << created.message() << endl;
+        return false;
+    }
+
+    standInText = true;
+    freeImage(scoreText.image);
+    scoreText = TextCache();
+    if (!makeStandInImage(coverImage, 64, 48, 0xFF4A7A2Eu, 0xFF2E5A1Au) ||
+        !makeStandInImage(gameOverScreenImage, 64, 48, 0xFF20208Au, 0xFF101050u) ||
+        !makeStandInImage(regularFoodImage, 16, 16, 0xFF2020E0u, 0x00000000u) ||
+        !makeStandInImage(bonusFoodImage, 16, 16, 0xFF20C0F0u, 0x80FFFFFFu))
+    {
+        cout << "Could not create golden stand-in images! SDL Error: " << SDL_GetError() << endl;
+        return false;
+    }
+
+    BenchFixture fixture;
+    fixture.cycle = buildBoardCycle();
+    const BenchLayout classic = {"classic", &classicLevel};
+
+    struct GoldenFrame
+    {
+        const char *name;
+        int length;
+        bool bonus;
+        Scene scene;
+    };
+    const GoldenFrame frames[] = {
+        {"menu", 1, false, SCENE_MENU},
+        {"start", 1, false, SCENE_PLAYING},
+        {"long_snake", 300, false, SCENE_PLAYING},
+        {"bonus", 40, true, SCENE_PLAYING},
+        {"paused", 300, false, SCENE_PAUSED},
+        {"game_over", 300, true, SCENE_GAME_OVER},
+        {"final_score", 1, false, SCENE_FINAL_SCORE}};
+
+    bool ok = true;
+    for (const GoldenFrame &golden : frames)
+    {
+        setupBenchFixture(fixture, golden.length, 16, classic);
+        fixture.game.score = golden.length * 5;
+        if (golden.bonus)
+        {
+            fixture.game.bonusFoodActive = true;
+            fixture.game.bonusFood = {SCREEN_WIDTH / 2, SCREEN_HEIGHT / 3};
+        }
+
+        switch (golden.scene)
+        {
+        case SCENE_MENU:
+            renderMenu(renderer);
+            break;
+        case SCENE_PAUSED:
+            renderPaused(renderer, fixture.game);
+            break;
+        case SCENE_GAME_OVER:
+            renderGameOver(renderer, fixture.game);
+            break;
+        case SCENE_FINAL_SCORE:
+            renderFinalScore(renderer, fixture.game);
+            break;
+        default:
+            renderGame(renderer, fixture.game);
+            break;
+        }
+
+        string reference = string(dir) + "/" + golden.name + ".tga";
+        if (update)
+        {
+            bool written = writeFrameTga(frame, reference);
+            cout << "golden " << golden.name << ": " << (written ? "reference written" : "could not write reference")
+                 << endl;
+            ok = written && ok;
+            continue;
+        }
+
+        vector<Uint32> expected;
+        int width, height;
+        if (!readFrameTga(expected, width, height, reference))
+        {
+            cout << "golden " << golden.name << ": no reference at " << reference << " (run --golden-update)" << endl;
+            ok = false;
+            continue;
+        }
+
+        long differing = 0;
+        if (width != frame.width || height != frame.height)
+        {
+            differing = (long)frame.pixels.size();
+        }
+        else
+        {
+            for (size_t i = 0; i < expected.size(); i++)
+            {
+                differing += expected[i] != frame.pixels[i];
+            }
+        }
+
+        if (differing == 0)
+        {
+            cout << "golden " << golden.name << ": ok" << endl;
+        }
+        else
+        {
+            writeFrameTga(frame, string(dir) + "/" + golden.name + ".actual.tga");
+            cout << "golden " << golden.name << ": " << differing << " pixels differ" << endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// --alloc-gate: plays the current level unattended with every timed rule,
+// rendering each tick as a frame, restarting on any collision. Once past
+// ALLOC_GATE_WARMUP_TICKS, any allocation by the simulation or effects fails
+// the run. Rendering is reported but not gated, since text is re-rendered
+// whenever the score changes.
+const long ALLOC_GATE_WARMUP_TICKS = 50;
+const int ALLOC_GATE_REPORTED = 10;
+
+bool runAllocationGate(SDL_Renderer *renderer, long ticks)
+{
+    GameState game;
+    Uint32 seed = 1;
+    resetGame(game, levels[currentLevel], seed, RULES_ALL);
+    clearParticles(particles);
+    resetAllocationFrame();
+
+    long failures = 0, games = 1, renderFrames = 0;
+    Uint64 renderCount = 0;
+    for (long tick = 0; tick < ALLOC_GATE_WARMUP_TICKS + ticks; tick++)
+    {
+        TickResult result;
+        {
+            AllocationScope scope(ALLOC_SIMULATION);
+            steerSnake(game, autopilotKey(game));
+            result = tickGame(game);
+        }
+        {
+            AllocationScope scope(ALLOC_EFFECTS);
+            emitTickEffects(particles, game, result);
+            advanceParticles(particles);
+        }
+        if (result.collision != COLLISION_NONE)
+        {
+            AllocationScope scope(ALLOC_SIMULATION);
+            resetGame(game, levels[currentLevel], ++seed, RULES_ALL);
+            games++;
+        }
+        {
+            AllocationScope scope(ALLOC_RENDER);
+            renderPlaying(renderer, game);
+            presentFrame(renderer);
+        }
+
+        const AllocationFrame &frame = endAllocationFrame("gate");
+        if (tick < ALLOC_GATE_WARMUP_TICKS)
+        {
+            continue;
+        }
+        Uint64 gated = frame.count[ALLOC_SIMULATION] + frame.count[ALLOC_EFFECTS];
+        if (gated > 0 && failures++ < ALLOC_GATE_REPORTED)
+        {
+            cout << "Tick " << tick << ": simulation allocated " << frame.count[ALLOC_SIMULATION] << " times ("
+                 << frame.bytes[ALLOC_SIMULATION] << " bytes), effects " << frame.count[ALLOC_EFFECTS] << " times ("
+                 << frame.bytes[ALLOC_EFFECTS] << " bytes)" << endl;
+        }
+        Uint64 rendering = frame.count[ALLOC_RENDER] + frame.count[ALLOC_TEXT];
+        renderCount += rendering;
+        renderFrames += rendering > 0;
+    }
+
+    cout << "Allocation gate: " << ticks << " steady-state ticks over " << games << " games, " << failures
+         << " ticks allocating in simulation or effects; rendering allocated " << renderCount << " times in "
+         << renderFrames << " frames" << endl;
+    cout << (failures == 0 ? "Allocation gate passed" : "Allocation gate FAILED") << endl;
+    return failures == 0;
+}
+
+const int PIPELINE_CHECK_GAMES = 5;
+
+// Plays PIPELINE_CHECK_GAMES pipelined games in which the snake runs
+// straight into the wall with food on the last cell before it, so the eat
+// and the collision come on consecutive ticks; with rendering slowed, both
+// usually land between two frames. Every event sent must be played.
+bool checkPipelinedEvents(SDL_Renderer *renderer)
+{
+    pipelinedMode = true;
+    autopilot = false;
+    Uint64 sent = 0, lost = 0, batched = 0;
+    for (int i = 0; i < PIPELINE_CHECK_GAMES; i++)
+    {
+        GameState game;
+        resetGame(game, levels[currentLevel], i + 1, gameRules);
+        clearParticles(particles);
+        dirty.valid = false;
+        if (game.dirX == 0 && game.dirY == 0)
+        {
+            game.dirX = 1;
+        }
+        SnakeSegment cell = game.snake[0];
+        while (true)
+        {
+            SnakeSegment next = {cell.x + game.dirX * SNAKE_VELOCITY, cell.y + game.dirY * SNAKE_VELOCITY};
+            if (hitsWall(*game.level, next) || hitsObstacle(game, next))
+            {
+                break;
+            }
+            cell = next;
+        }
+        game.food.x = cell.x;
+        game.food.y = cell.y;
+
+        Scene next = SCENE_PLAYING;
+        while (next == SCENE_PLAYING)
+        {
+            next = pipelinedPlayingScene(renderer, game);
+            if (next == SCENE_PLAYING)
+            {
+                SDL_Delay(sceneDelayMs(SCENE_PLAYING, game));
+            }
+        }
+        stopSimulation();
+        if (next == SCENE_QUIT)
+        {
+            break;
+        }
+        sent += pipelineEvents.sent;
+        lost += pipelineEvents.sent - pipelineEvents.played;
+        batched += pipelineEvents.batched;
+    }
+
+    cout << "Pipelined events (eat, then collide): " << sent << " sent, " << lost << " not played; " << batched
+         << " frames played several ticks' events" << endl;
+    return lost == 0;
+}
+
+// --pipeline-bench: plays the current level under the autopilot for the
+// given time serially and then pipelined, with rendering slowed by
+// --slow-render, and reports tick jitter and frame time for each. Then
+// checks that pipelined play misses no events: see checkPipelinedEvents.
+bool runPipelineBenchmark(SDL_Renderer *renderer, double seconds)
+{
+    autopilot = true;
+    for (int pipelined = 0; pipelined < 2; pipelined++)
+    {
+        pipelinedMode = pipelined != 0;
+        tickJitter = TickJitter();
+        frameTimes = FrameTimes();
+
+        GameState game;
+        Uint32 seed = 1;
+        resetGame(game, levels[currentLevel], seed, gameRules);
+        clearParticles(particles);
+        dirty.valid = false;
+
+        Uint64 end = SDL_GetPerformanceCounter() + (Uint64)(seconds * SDL_GetPerformanceFrequency());
+        while (SDL_GetPerformanceCounter() < end)
+        {
+            Scene next = pipelinedMode ? pipelinedPlayingScene(renderer, game) : playingScene(renderer, game);
+            if (next == SCENE_QUIT)
+            {
+                break;
+            }
+            if (next != SCENE_PLAYING)
+            {
+                resetGame(game, levels[currentLevel], ++seed, gameRules);
+                clearParticles(particles);
+                dirty.valid = false;
+                tickJitter.last = 0;
+                continue;
+            }
+            SDL_Delay(sceneDelayMs(SCENE_PLAYING, game));
+        }
+        stopSimulation();
+        reportPlayTiming();
+    }
+
+    bool ok = checkPipelinedEvents(renderer);
+    shutdownSimulation();
+    pipelinedMode = false;
+    return ok;
+}
+
+// Development harness: the benchmark suite, golden frames, the allocation
+// gate and the pipeline benchmark, plus the level compiler and asset packer
+// build steps. --renderer, --levels, --assets and the rule and rendering
+// switches mean what they do for the game, as does --level for the modes
+// that play a level (--alloc-gate and --pipeline-bench).
+int main(int argc, char *args[])
+{
+    const char *benchOutput = nullptr;
+    const char *goldenDir = nullptr;
+    bool goldenUpdate = false;
+    bool compileOnly = false;
+    bool packOnly = false;
+    bool looseAssets = false;
+    const char *startLevel = nullptr;
+    long allocationGateTicks = 0;
+    double pipelineBenchSeconds = 0;
+    hookAllocator();
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc && strncmp(args[i + 1], "--", 2) != 0;
+        if (strcmp(args[i], "--bench") == 0)
+        {
+            benchOutput = hasValue ? args[++i] : "bench_results.json";
+        }
+        else if (strcmp(args[i], "--golden") == 0 || strcmp(args[i], "--golden-update") == 0)
+        {
+            goldenUpdate = strcmp(args[i], "--golden-update") == 0;
+            goldenDir = hasValue ? args[++i] : "golden";
+            renderBackend = BACKEND_RASTER;
+        }
+        else if (strcmp(args[i], "--renderer") == 0 && hasValue)
+        {
+            renderBackend = strcmp(args[++i], "raster") == 0 ? BACKEND_RASTER : BACKEND_SDL;
+        }
+        else if (strcmp(args[i], "--alloc-gate") == 0)
+        {
+            allocationGateTicks = hasValue ? max(1L, atol(args[++i])) : 5000;
+        }
+        else if (strcmp(args[i], "--slow-render") == 0 && hasValue)
+        {
+            slowRenderMs = (Uint32)max(0, atoi(args[++i]));
+        }
+        else if (strcmp(args[i], "--pipeline-bench") == 0)
+        {
+            pipelineBenchSeconds = hasValue ? max(1.0, atof(args[++i])) : 10;
+        }
+        else if (strcmp(args[i], "--dirty-rects") == 0)
+        {
+            dirtyRectMode = true;
+        }
+        else if (strcmp(args[i], "--classic-rules") == 0)
+        {
+            gameRules = RULES_CLASSIC;
+        }
+        else if (strcmp(args[i], "--levels") == 0 && hasValue)
+        {
+            levelsDirectory = args[++i];
+        }
+        else if (strcmp(args[i], "--level") == 0 && hasValue)
+        {
+            startLevel = args[++i];
+        }
+        else if (strcmp(args[i], "--compile-levels") == 0)
+        {
+            compileOnly = true;
+            if (hasValue)
+            {
+                levelsDirectory = args[++i];
+            }
+        }
+        else if (strcmp(args[i], "--pack-assets") == 0)
+        {
+            packOnly = true;
+            if (hasValue)
+            {
+                assetBundlePath = args[++i];
+            }
+        }
+        else if (strcmp(args[i], "--assets") == 0 && hasValue)
+        {
+            assetBundlePath = args[++i];
+        }
+        else if (strcmp(args[i], "--loose-assets") == 0)
+        {
+            looseAssets = true;
+        }
+    }
+
+    if (compileOnly)
+    {
+        // Build step only: no window, no audio
+        return compileLevels(levelsDirectory, false) ? 0 : -1;
+    }
+
+    if (packOnly)
+    {
+        // Build step: decodes with the game's libraries and mixer format, no window
+        SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+        bool ok = SDL_Init(SDL_INIT_AUDIO) == 0 && (IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) &&
+                  Mix_OpenAudio(AUDIO_FREQUENCY, MIX_DEFAULT_FORMAT, AUDIO_CHANNELS, AUDIO_BUFFER_SAMPLES) == 0;
+        if (!ok)
+        {
+            cout << "Could not initialize SDL for packing! SDL Error: " << SDL_GetError() << endl;
+        }
+        ok = ok && packAssets(assetBundlePath);
+        Mix_CloseAudio();
+        IMG_Quit();
+        SDL_Quit();
+        return ok ? 0 : -1;
+    }
+
+    if (benchOutput == nullptr && goldenDir == nullptr && allocationGateTicks == 0 && pipelineBenchSeconds == 0)
+    {
+        cout << "Usage: " << args[0]
+             << " --bench [out.json] | --golden [dir] | --golden-update [dir] | --alloc-gate [ticks] |"
+                " --pipeline-bench [seconds] | --compile-levels [dir] | --pack-assets [bundle]"
+             << endl;
+        return -1;
+    }
+
+    // The benchmarks and golden frames build their own boards
+    bool playsLevels = allocationGateTicks > 0 || pipelineBenchSeconds > 0;
+    if (startLevel != nullptr && !playsLevels)
+    {
+        cout << "--level applies only to --alloc-gate and --pipeline-bench" << endl;
+        return -1;
+    }
+
+    if (!allocationCounting && allocationGateTicks > 0)
+    {
+        cout << "Allocation counting is not built in; rebuild with -DSNAKE_ALLOC_STATS" << endl;
+        return -1;
+    }
+
+    launchCounter = SDL_GetPerformanceCounter();
+    if (!looseAssets)
+    {
+        mapAssets(assetBundlePath);
+    }
+
+    // No display, no audio device, software rasterization
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+    rendererFlags = SDL_RENDERER_SOFTWARE;
+
+    if (!initializeSDL(window, renderer))
+    {
+        cleanUp(window, renderer);
+        return -1;
+    }
+
+    if (playsLevels && !loadLevels(levelsDirectory))
+    {
+        cleanUp(window, renderer);
+        return -1;
+    }
+
+    if (startLevel != nullptr)
+    {
+        int level = findLevel(startLevel);
+        if (level < 0)
+        {
+            cout << "No level named " << startLevel << " in " << levelsDirectory << endl;
+            cleanUp(window, renderer);
+            return -1;
+        }
+        currentLevel = level;
+    }
+
+    bool ok = benchOutput != nullptr    ? runBenchmarks(renderer, benchOutput)
+              : goldenDir != nullptr    ? runGoldenFrames(renderer, goldenDir, goldenUpdate)
+              : allocationGateTicks > 0 ? runAllocationGate(renderer, allocationGateTicks)
+                                        : runPipelineBenchmark(renderer, pipelineBenchSeconds);
+    cleanUp(window, renderer);
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,195 @@
+#include "snake.h"
+
+using namespace std;
+
+int main(int argc, char *args[])
+{
+    const char *capturePath = nullptr;
+    const char *recordPath = nullptr;
+    const char *replayPath = nullptr;
+    const char *replayVideo = nullptr;
+    bool looseAssets = false;
+    bool coldStart = false;
+    const char *telemetryPath = nullptr;
+    long long telemetryRotateBytes = 64LL << 20;
+    const char *startLevel = nullptr;
+    const char *allocationLogPath = nullptr;
+    int spectateCount = 0;
+    vector<const char *> spectateReplays;
+    hookAllocator();
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc && strncmp(args[i + 1], "--", 2) != 0;
+        if (strcmp(args[i], "--renderer") == 0 && hasValue)
+        {
+            renderBackend = strcmp(args[++i], "raster") == 0 ? BACKEND_RASTER : BACKEND_SDL;
+        }
+        else if (strcmp(args[i], "--capture") == 0 && hasValue)
+        {
+            capturePath = args[++i];
+        }
+        else if (strcmp(args[i], "--record") == 0 && hasValue)
+        {
+            recordPath = args[++i];
+        }
+        else if (strcmp(args[i], "--render-replay") == 0 && i + 2 < argc)
+        {
+            replayPath = args[++i];
+            replayVideo = args[++i];
+            renderBackend = BACKEND_RASTER;
+        }
+        else if (strcmp(args[i], "--telemetry") == 0 && hasValue)
+        {
+            telemetryPath = args[++i];
+        }
+        else if (strcmp(args[i], "--telemetry-rotate-mb") == 0 && hasValue)
+        {
+            telemetryRotateBytes = max(1LL, atoll(args[++i])) << 20;
+        }
+        else if (strcmp(args[i], "--alloc-log") == 0 && hasValue)
+        {
+            allocationLogPath = args[++i];
+        }
+        else if (strcmp(args[i], "--pipelined") == 0)
+        {
+            pipelinedMode = true;
+        }
+        else if (strcmp(args[i], "--slow-render") == 0 && hasValue)
+        {
+            slowRenderMs = (Uint32)max(0, atoi(args[++i]));
+        }
+        else if (strcmp(args[i], "--spectate") == 0 && hasValue)
+        {
+            spectateCount = atoi(args[++i]);
+            while (i + 1 < argc && strncmp(args[i + 1], "--", 2) != 0)
+            {
+                spectateReplays.push_back(args[++i]);
+            }
+        }
+        else if (strcmp(args[i], "--dirty-rects") == 0)
+        {
+            dirtyRectMode = true;
+        }
+        else if (strcmp(args[i], "--classic-rules") == 0)
+        {
+            gameRules = RULES_CLASSIC;
+        }
+        else if (strcmp(args[i], "--levels") == 0 && hasValue)
+        {
+            levelsDirectory = args[++i];
+        }
+        else if (strcmp(args[i], "--level") == 0 && hasValue)
+        {
+            startLevel = args[++i];
+        }
+        else if (strcmp(args[i], "--assets") == 0 && hasValue)
+        {
+            assetBundlePath = args[++i];
+        }
+        else if (strcmp(args[i], "--loose-assets") == 0)
+        {
+            looseAssets = true;
+        }
+        else if (strcmp(args[i], "--cold-start") == 0)
+        {
+            coldStart = true;
+        }
+    }
+
+    if (coldStart)
+    {
+        evictAssetsFromCache();
+    }
+    launchCounter = SDL_GetPerformanceCounter();
+    if (!looseAssets)
+    {
+        mapAssets(assetBundlePath);
+    }
+
+    if (!allocationCounting && allocationLogPath != nullptr)
+    {
+        cout << "Allocation counting is not built in; rebuild with -DSNAKE_ALLOC_STATS" << endl;
+        return -1;
+    }
+    if (allocationLogPath != nullptr && !startAllocationLog(allocationLogPath))
+    {
+        return -1;
+    }
+
+    bool headless = replayPath != nullptr;
+    if (headless)
+    {
+        // No display, no audio device, software rasterization
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+        SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+        rendererFlags = SDL_RENDERER_SOFTWARE;
+    }
+
+    if (!initializeSDL(window, renderer))
+    {
+        cleanUp(window, renderer);
+        return -1;
+    }
+
+    if (!loadLevels(levelsDirectory))
+    {
+        cleanUp(window, renderer);
+        return -1;
+    }
+
+    if (startLevel != nullptr)
+    {
+        int level = findLevel(startLevel);
+        if (level < 0)
+        {
+            cout << "No level named " << startLevel << " in " << levelsDirectory << endl;
+            cleanUp(window, renderer);
+            return -1;
+        }
+        currentLevel = level;
+    }
+
+    if (headless)
+    {
+        bool ok = renderReplay(renderer, replayPath, replayVideo);
+        stopAllocationLog();
+        cleanUp(window, renderer);
+        return ok ? 0 : -1;
+    }
+
+    if (!playBackgroundMusic("audio/background_music.mp3"))
+    {
+        cleanUp(window, renderer);
+        return -1;
+    }
+
+    if ((capturePath != nullptr && !startCapture(capturePath, false)) ||
+        (recordPath != nullptr && !startRecording(recordPath)) ||
+        (telemetryPath != nullptr && !startTelemetry(telemetryPath, telemetryRotateBytes)))
+    {
+        cleanUp(window, renderer);
+        return -1;
+    }
+
+    bool ok = true;
+    if (spectateCount > 0)
+    {
+        ok = runSpectatorWall(renderer, spectateCount, spectateReplays);
+    }
+    else
+    {
+        runScenes(renderer);
+    }
+
+    stopCapture();
+    stopRecording();
+    stopTelemetry();
+    reportDirtyRects();
+    reportAllocations();
+    reportPlayTiming();
+    stopAllocationLog();
+
+    cleanUp(window, renderer);
+
+    return ok ? 0 : -1;
+}
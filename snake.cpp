@@ -1,22 +1,4 @@
-#include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
-#include <SDL2/SDL_mixer.h>
-#include <SDL2/SDL_ttf.h>
-#include <bits/stdc++.h>
-#include <vector>
-#include <cstdlib>
-#include <ctime>
-
-void renderText(SDL_Renderer *renderer, const char *message, int x, int y, SDL_Color color);
-void renderStartButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor);
-void renderExitButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor);
-void renderGameOverButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor);
-void renderRestartButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor);
-void drawCircle(SDL_Renderer *renderer, int centerX, int centerY, int radius);
-void displayGameOverScreen(SDL_Renderer *renderer, int score);
-void GameStarted(SDL_Renderer *renderer);
-void GameLoop(SDL_Renderer *renderer);
-void cleanUp(SDL_Window *window, SDL_Renderer *renderer);
+#include "snake.h"
 
 SDL_Window *window = nullptr;
 SDL_Renderer *renderer = nullptr;
@@ -28,906 +10,5337 @@ TTF_Font *game_over = nullptr;
 Mix_Chunk *eatingSound = nullptr;
 Mix_Chunk *bonusEatingSound = nullptr;
 Mix_Chunk *gameOverSound = nullptr;
+SDL_Cursor *arrowCursor = nullptr;
+SDL_Cursor *handCursor = nullptr;
+Uint32 rendererFlags = SDL_RENDERER_ACCELERATED;
+
+RenderBackend renderBackend = BACKEND_SDL;
+bool dirtyRectMode = false;
+SDL_Point drawOrigin = {0, 0};
+bool standInText = false;
+Uint64 launchCounter = 0;
+Uint32 gameRules = RULES_ALL;
+SDL_Texture *dirtyTarget = nullptr;
+Framebuffer frame;
+Image coverImage;
+Image gameOverScreenImage;
+Image regularFoodImage;
+Image bonusFoodImage;
 
-const int SCREEN_WIDTH = 800;
-const int SCREEN_HEIGHT = 600;
+using namespace std;
 
-struct SnakeSegment
+void resizeFramebuffer(Framebuffer &fb, int width, int height)
 {
-    int x, y;
-};
-
-using namespace std;
+    fb.width = width;
+    fb.height = height;
+    fb.pixels.assign((size_t)width * height, 0xFF000000);
+    fb.row.assign(width, 0);
+    fb.clip = {0, 0, width, height};
+}
 
-bool initializeSDL(SDL_Window *&window, SDL_Renderer *&renderer)
+void fillSpan(Uint32 *dst, int count, Uint32 color)
 {
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
+    int i = 0;
+#if defined(__AVX2__)
+    __m256i wide = _mm256_set1_epi32((int)color);
+    for (; i + 8 <= count; i += 8)
     {
-        cout << "SDL could not initialize! SDL Error: " << SDL_GetError() << endl;
-        return false;
+        _mm256_storeu_si256((__m256i *)(dst + i), wide);
     }
-
-    if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG))
+#endif
+#if defined(__SSE2__)
+    __m128i narrow = _mm_set1_epi32((int)color);
+    for (; i + 4 <= count; i += 4)
     {
-        cout << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << endl;
-        return false;
+        _mm_storeu_si128((__m128i *)(dst + i), narrow);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        dst[i] = color;
     }
+}
 
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0)
+// Source-over blend with exact rounding: (s*a + d*(255-a)) / 255 computed as
+// (x + 128 + ((x + 128) >> 8)) >> 8. The SIMD paths use the same integer
+// math, so every path produces identical pixels.
+inline Uint32 blendPixel(Uint32 dst, Uint32 src)
+{
+    Uint32 a = src >> 24;
+    Uint32 out = 0xFF000000;
+    for (int shift = 0; shift < 24; shift += 8)
     {
-        cout << "SDL_mixer could not initialize! SDL_mixer Error: " << Mix_GetError() << endl;
-        return false;
+        Uint32 x = ((src >> shift) & 0xFF) * a + ((dst >> shift) & 0xFF) * (255 - a) + 128;
+        out |= ((x + (x >> 8)) >> 8) << shift;
     }
+    return out;
+}
 
-    if (TTF_Init() == -1)
+void blendSpan(Uint32 *dst, const Uint32 *src, int count)
+{
+    int i = 0;
+#if defined(__AVX2__)
     {
-        cout << "SDL_ttf could not initialize! SDL_ttf Error: " << TTF_GetError() << endl;
-        return false;
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i c255 = _mm256_set1_epi16(255);
+        const __m256i c128 = _mm256_set1_epi16(128);
+        const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+            __m256i alpha = _mm256_srli_epi32(s, 24);
+            if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, zero)) == -1)
+                continue;
+            if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, _mm256_set1_epi32(255))) == -1)
+            {
+                _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(s, opaque));
+                continue;
+            }
+
+            __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+            __m256i sl = _mm256_unpacklo_epi8(s, zero), sh = _mm256_unpackhi_epi8(s, zero);
+            __m256i dl = _mm256_unpacklo_epi8(d, zero), dh = _mm256_unpackhi_epi8(d, zero);
+            __m256i al = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sl, 0xFF), 0xFF);
+            __m256i ah = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sh, 0xFF), 0xFF);
+            __m256i xl = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(sl, al), _mm256_mullo_epi16(dl, _mm256_sub_epi16(c255, al))), c128);
+            __m256i xh = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(sh, ah), _mm256_mullo_epi16(dh, _mm256_sub_epi16(c255, ah))), c128);
+            xl = _mm256_srli_epi16(_mm256_add_epi16(xl, _mm256_srli_epi16(xl, 8)), 8);
+            xh = _mm256_srli_epi16(_mm256_add_epi16(xh, _mm256_srli_epi16(xh, 8)), 8);
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(_mm256_packus_epi16(xl, xh), opaque));
+        }
     }
+#endif
+#if defined(__SSE2__)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i c255 = _mm_set1_epi16(255);
+        const __m128i c128 = _mm_set1_epi16(128);
+        const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i alpha = _mm_srli_epi32(s, 24);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) == 0xFFFF)
+                continue;
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, _mm_set1_epi32(255))) == 0xFFFF)
+            {
+                _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(s, opaque));
+                continue;
+            }
 
-    window = SDL_CreateWindow("SDL Full-Window Image", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
-    if (window == nullptr)
+            __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+            __m128i sl = _mm_unpacklo_epi8(s, zero), sh = _mm_unpackhi_epi8(s, zero);
+            __m128i dl = _mm_unpacklo_epi8(d, zero), dh = _mm_unpackhi_epi8(d, zero);
+            __m128i al = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sl, 0xFF), 0xFF);
+            __m128i ah = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sh, 0xFF), 0xFF);
+            __m128i xl = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(sl, al), _mm_mullo_epi16(dl, _mm_sub_epi16(c255, al))), c128);
+            __m128i xh = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(sh, ah), _mm_mullo_epi16(dh, _mm_sub_epi16(c255, ah))), c128);
+            xl = _mm_srli_epi16(_mm_add_epi16(xl, _mm_srli_epi16(xl, 8)), 8);
+            xh = _mm_srli_epi16(_mm_add_epi16(xh, _mm_srli_epi16(xh, 8)), 8);
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(_mm_packus_epi16(xl, xh), opaque));
+        }
+    }
+#endif
+    for (; i < count; i++)
     {
-        cout << "Window could not be created! SDL Error: " << SDL_GetError() << endl;
-        return false;
+        dst[i] = blendPixel(dst[i], src[i]);
     }
+}
 
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-    if (renderer == nullptr)
+void rasterFillRect(Framebuffer &fb, const SDL_Rect &rect, Uint32 color)
+{
+    SDL_Rect visible;
+    if (!SDL_IntersectRect(&rect, &fb.clip, &visible))
     {
-        cout << "Renderer could not be created! SDL Error: " << SDL_GetError() << endl;
-        return false;
+        return;
     }
 
-    font = TTF_OpenFont("Fonts/arial.ttf", 28);
-    if (font == nullptr)
+    for (int y = visible.y; y < visible.y + visible.h; y++)
     {
-        cout << "Failed to load font! SDL_ttf Error: " << TTF_GetError() << endl;
-        return false;
+        fillSpan(&fb.pixels[(size_t)y * fb.width + visible.x], visible.w, color);
     }
+}
 
-    score = TTF_OpenFont("Fonts/score.otf", 18);
-    if (score == nullptr)
+// Covers exactly the pixels drawCircle plots with SDL_RenderDrawPoint, one
+// span per row.
+void rasterFillCircle(Framebuffer &fb, int centerX, int centerY, int radius, Uint32 color)
+{
+    for (int dy = -radius + 1; dy <= radius; dy++)
     {
-        cout << "Failed to load score font! SDL_ttf Error: " << TTF_GetError() << endl;
-        return false;
+        int y = centerY + dy;
+        if (y < fb.clip.y || y >= fb.clip.y + fb.clip.h)
+        {
+            continue;
+        }
+
+        int reach = (int)sqrt((double)(radius * radius - dy * dy));
+        while (reach * reach > radius * radius - dy * dy)
+            reach--;
+        while ((reach + 1) * (reach + 1) <= radius * radius - dy * dy)
+            reach++;
+
+        int x0 = max(centerX + max(-reach, -radius + 1), fb.clip.x);
+        int x1 = min(centerX + min(reach, radius), fb.clip.x + fb.clip.w - 1);
+        if (x0 <= x1)
+        {
+            fillSpan(&fb.pixels[(size_t)y * fb.width + x0], x1 - x0 + 1, color);
+        }
     }
+}
 
-    game_over = TTF_OpenFont("Fonts/game_over.ttf", 28);
-    if (game_over == nullptr)
+void rasterBlendRect(Framebuffer &fb, const SDL_Rect &rect, Uint32 color)
+{
+    SDL_Rect visible;
+    if (!SDL_IntersectRect(&rect, &fb.clip, &visible))
     {
-        cout << "Failed to load game over font! SDL_ttf Error: " << TTF_GetError() << endl;
-        return false;
+        return;
     }
 
-    finalScore = TTF_OpenFont("Fonts/finalScore.otf", 30);
-    if (finalScore == nullptr)
+    for (int y = visible.y; y < visible.y + visible.h; y++)
     {
-        cout << "Failed to load final score font! SDL_ttf Error: " << TTF_GetError() << endl;
-        return false;
+        Uint32 *dst = &fb.pixels[(size_t)y * fb.width + visible.x];
+        for (int x = 0; x < visible.w; x++)
+        {
+            dst[x] = blendPixel(dst[x], color);
+        }
     }
+}
 
-    eatingSound = Mix_LoadWAV("audio/eating_sound.wav");
-    if (eatingSound == nullptr)
+// Alpha-blends an RGBA32 surface into dst (or the whole framebuffer), scaling
+// with nearest-neighbour sampling like SDL_RenderCopy's default.
+void rasterBlit(Framebuffer &fb, const SDL_Surface *image, const SDL_Rect *dst)
+{
+    SDL_Rect target = dst ? *dst : SDL_Rect{0, 0, fb.width, fb.height};
+    SDL_Rect visible;
+    if (image == nullptr || target.w <= 0 || target.h <= 0 || !SDL_IntersectRect(&target, &fb.clip, &visible))
     {
-        cout << "Failed to load eating sound effect! SDL_mixer Error: " << Mix_GetError() << endl;
-        return false;
+        return;
     }
 
-    bonusEatingSound = Mix_LoadWAV("audio/bonus_eating_sound.mp3");
-    if (bonusEatingSound == nullptr)
+    bool scaled = target.w != image->w || target.h != image->h;
+    for (int y = visible.y; y < visible.y + visible.h; y++)
     {
-        cout << "Failed to load eating sound effect! SDL_mixer Error: " << Mix_GetError() << endl;
-        return false;
+        int sy = (int)((long long)(y - target.y) * image->h / target.h);
+        const Uint32 *srcRow = (const Uint32 *)((const Uint8 *)image->pixels + (size_t)sy * image->pitch);
+        const Uint32 *src = srcRow + (visible.x - target.x);
+        if (scaled)
+        {
+            // Steps floor(x * image->w / target.w) without a divide per pixel
+            long long start = (long long)(visible.x - target.x) * image->w;
+            int sx = (int)(start / target.w), remainder = (int)(start % target.w);
+            for (int x = 0; x < visible.w; x++)
+            {
+                fb.row[x] = srcRow[sx];
+                for (remainder += image->w; remainder >= target.w; remainder -= target.w)
+                    sx++;
+            }
+            src = fb.row.data();
+        }
+        blendSpan(&fb.pixels[(size_t)y * fb.width + visible.x], src, visible.w);
     }
+}
 
-    gameOverSound = Mix_LoadWAV("audio/game_over_sound.wav");
-    if (eatingSound == nullptr)
+// Frame capture. presentFrame hands every frame to captureFrame, which copies
+// it into a preallocated buffer and passes the buffer's index to a writer
+// thread through a lock-free single-producer/single-consumer ring. The game
+// loop never waits on disk: when the writer falls behind, frames are first
+// thinned out and then dropped. The copy itself stays on the game thread: on
+// the SDL backend it is SDL_RenderReadPixels, which SDL2 can only do
+// synchronously and which waits for the GPU to finish the frame, so its cost
+// is reported separately. The raster backend copies from memory.
+//
+// Y4M declares a fixed rate of one frame per CAPTURE_FRAME_MS, so the writer
+// places every frame by its timestamp: gaps left by dropped, throttled or
+// slow frames repeat the previous frame, and a frame landing on an already
+// written slot is skipped. Raw captures keep every frame and its timestamp.
+const int CAPTURE_POOL_SIZE = 8;
+const Uint32 CAPTURE_FRAME_MS = 100;
+
+struct FrameQueue
+{
+    static const unsigned CAPACITY = 16; // power of two, > CAPTURE_POOL_SIZE
+    int slots[CAPACITY];
+    std::atomic<unsigned> head{0};
+    std::atomic<unsigned> tail{0};
+};
+
+bool pushFrame(FrameQueue &queue, int index)
+{
+    unsigned tail = queue.tail.load(std::memory_order_relaxed);
+    if (tail - queue.head.load(std::memory_order_acquire) == FrameQueue::CAPACITY)
     {
-        cout << "Failed to load game over sound effect! SDL_mixer Error: " << Mix_GetError() << endl;
         return false;
     }
-
+    queue.slots[tail % FrameQueue::CAPACITY] = index;
+    queue.tail.store(tail + 1, std::memory_order_release);
     return true;
 }
 
-bool loadAndRenderImage(SDL_Renderer *renderer, const char *filePath)
+bool popFrame(FrameQueue &queue, int &index)
 {
-    SDL_Texture *texture = IMG_LoadTexture(renderer, filePath);
-    if (texture == nullptr)
+    unsigned head = queue.head.load(std::memory_order_relaxed);
+    if (head == queue.tail.load(std::memory_order_acquire))
     {
-        cout << "Failed to load texture! SDL_image Error: " << IMG_GetError() << endl;
         return false;
     }
+    index = queue.slots[head % FrameQueue::CAPACITY];
+    queue.head.store(head + 1, std::memory_order_release);
+    return true;
+}
 
-    SDL_SetRenderDrawColor(renderer, 205, 20, 205, 255);
-    SDL_RenderClear(renderer);
-
-    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+unsigned queuedFrames(const FrameQueue &queue)
+{
+    return queue.tail.load(std::memory_order_acquire) - queue.head.load(std::memory_order_acquire);
+}
 
-    SDL_RenderPresent(renderer);
+struct Capture
+{
+    bool active = false;
+    bool offline = false; // rendering a replay: wait for buffers, never drop
+    bool y4m = true;      // otherwise raw RGBA32 frames plus a text index
+    int width = 0, height = 0;
+    FILE *video = nullptr;
+    FILE *index = nullptr;
+    std::vector<std::vector<Uint8>> buffers;
+    std::vector<Uint32> timestamps;
+    FrameQueue filled; // game -> writer
+    FrameQueue free;   // writer -> game
+    std::thread writer;
+    std::atomic<bool> stopping{false};
+    Uint32 startTicks = 0, lastCaptureTicks = 0;
+    Uint32 offlineMs = 0; // game time of the next offline frame, advanced by the renderer
+    long frames = 0, dropped = 0, throttled = 0;
+    long repeated = 0, skipped = 0; // Y4M timeline fill, counted by the writer
+    double overheadTotalMs = 0, overheadWorstMs = 0, readbackTotalMs = 0;
+};
 
-    SDL_DestroyTexture(texture);
-    return true;
-}
+Capture capture;
 
-void renderText(SDL_Renderer *renderer, const char *message, int x, int y, SDL_Color color)
+void writeY4mFrame(FILE *video, const Uint8 *rgba, int width, int height, std::vector<Uint8> &yuv)
 {
-    SDL_Surface *surface = TTF_RenderText_Solid(font, message, color);
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+    // BT.601 full range ("C420jpeg"), chroma from the average of each 2x2 block
+    Uint8 *yPlane = yuv.data();
+    Uint8 *uPlane = yPlane + width * height;
+    Uint8 *vPlane = uPlane + (width / 2) * (height / 2);
 
-    SDL_Rect dstrect = {x, y, surface->w, surface->h};
-    SDL_RenderCopy(renderer, texture, nullptr, &dstrect);
+    for (int i = 0; i < width * height; i++)
+    {
+        const Uint8 *p = rgba + i * 4;
+        yPlane[i] = (Uint8)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+    }
 
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
+    for (int y = 0; y < height / 2; y++)
+    {
+        for (int x = 0; x < width / 2; x++)
+        {
+            const Uint8 *p0 = rgba + ((y * 2) * width + x * 2) * 4;
+            const Uint8 *p1 = p0 + width * 4;
+            int r = (p0[0] + p0[4] + p1[0] + p1[4] + 2) / 4;
+            int g = (p0[1] + p0[5] + p1[1] + p1[5] + 2) / 4;
+            int b = (p0[2] + p0[6] + p1[2] + p1[6] + 2) / 4;
+            int u = ((-43 * r - 85 * g + 128 * b + 128) >> 8) + 128;
+            int v = ((128 * r - 107 * g - 21 * b + 128) >> 8) + 128;
+            uPlane[y * (width / 2) + x] = (Uint8)min(max(u, 0), 255);
+            vPlane[y * (width / 2) + x] = (Uint8)min(max(v, 0), 255);
+        }
+    }
+
+    fputs("FRAME\n", video);
+    fwrite(yuv.data(), 1, yuv.size(), video);
 }
 
-void scoreRenderText(SDL_Renderer *renderer, const char *message, int x, int y, SDL_Color color)
+void captureWriterLoop()
 {
-    SDL_Surface *surface = TTF_RenderText_Solid(score, message, color);
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+    std::vector<Uint8> yuv((size_t)capture.width * capture.height * 3 / 2);
+    long written = 0;
+    long nextSlot = -1; // Y4M timeline position of the next frame written
+
+    while (true)
+    {
+        int slot;
+        if (!popFrame(capture.filled, slot))
+        {
+            if (capture.stopping.load(std::memory_order_acquire) && queuedFrames(capture.filled) == 0)
+            {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
 
-    SDL_Rect dstrect = {x, y, surface->w, surface->h};
-    SDL_RenderCopy(renderer, texture, nullptr, &dstrect);
+        const std::vector<Uint8> &pixels = capture.buffers[slot];
+        if (capture.y4m)
+        {
+            long due = (long)((capture.timestamps[slot] + CAPTURE_FRAME_MS / 2) / CAPTURE_FRAME_MS);
+            if (nextSlot < 0)
+            {
+                nextSlot = due;
+            }
+            for (; nextSlot < due; nextSlot++)
+            {
+                fputs("FRAME\n", capture.video);
+                fwrite(yuv.data(), 1, yuv.size(), capture.video);
+                capture.repeated++;
+            }
+            if (due < nextSlot)
+            {
+                capture.skipped++;
+                pushFrame(capture.free, slot);
+                continue;
+            }
+            writeY4mFrame(capture.video, pixels.data(), capture.width, capture.height, yuv);
+            nextSlot++;
+        }
+        else
+        {
+            fprintf(capture.index, "%ld %u\n", written * (long)pixels.size(), capture.timestamps[slot]);
+            fwrite(pixels.data(), 1, pixels.size(), capture.video);
+        }
+        written++;
 
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
+        pushFrame(capture.free, slot);
+    }
 }
 
-void finalScoreRenderText(SDL_Renderer *renderer, const char *message, int x, int y, SDL_Color color)
+// Starts writing frames to path: .y4m for YUV4MPEG2, anything else for raw
+// RGBA32 frames with "<offset> <ms>" lines in path.idx.
+bool startCapture(const char *path, bool offline)
 {
-    SDL_Surface *surface = TTF_RenderText_Solid(finalScore, message, color);
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+    capture.width = SCREEN_WIDTH;
+    capture.height = SCREEN_HEIGHT;
+    capture.offline = offline;
+    size_t length = strlen(path);
+    capture.y4m = length >= 4 && strcmp(path + length - 4, ".y4m") == 0;
+
+    capture.video = fopen(path, "wb");
+    if (capture.video == nullptr)
+    {
+        cout << "Failed to open capture output " << path << endl;
+        return false;
+    }
+
+    if (capture.y4m)
+    {
+        fprintf(capture.video, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg\n", capture.width, capture.height, 1000 / CAPTURE_FRAME_MS);
+    }
+    else
+    {
+        string indexPath = string(path) + ".idx";
+        capture.index = fopen(indexPath.c_str(), "w");
+        if (capture.index == nullptr)
+        {
+            cout << "Failed to open capture index " << indexPath << endl;
+            fclose(capture.video);
+            capture.video = nullptr;
+            return false;
+        }
+        fprintf(capture.index, "%d %d RGBA32\n", capture.width, capture.height);
+    }
 
-    SDL_Rect dstrect = {x, y, surface->w, surface->h};
-    SDL_RenderCopy(renderer, texture, nullptr, &dstrect);
+    capture.buffers.assign(CAPTURE_POOL_SIZE, std::vector<Uint8>((size_t)capture.width * capture.height * 4));
+    capture.timestamps.assign(CAPTURE_POOL_SIZE, 0);
+    for (int i = 0; i < CAPTURE_POOL_SIZE; i++)
+    {
+        pushFrame(capture.free, i);
+    }
 
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
+    capture.stopping = false;
+    capture.startTicks = SDL_GetTicks();
+    capture.offlineMs = 0;
+    capture.writer = std::thread(captureWriterLoop);
+    capture.active = true;
+    return true;
 }
 
-void gameOverRenderText(SDL_Renderer *renderer, const char *message, int x, int y, SDL_Color color)
+void captureFrame(SDL_Renderer *renderer)
 {
-    SDL_Surface *surface = TTF_RenderText_Solid(game_over, message, color);
-    SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+    Uint32 now = SDL_GetTicks();
+    if (!capture.offline && now - capture.lastCaptureTicks < CAPTURE_FRAME_MS - CAPTURE_FRAME_MS / 10)
+    {
+        return; // menus redraw at ~60 Hz; the video runs at the tick rate
+    }
 
-    SDL_Rect dstrect = {x, y, surface->w, surface->h};
-    SDL_RenderCopy(renderer, texture, nullptr, &dstrect);
+    Uint64 start = SDL_GetPerformanceCounter();
 
-    SDL_FreeSurface(surface);
-    SDL_DestroyTexture(texture);
+    // Backpressure: with under a quarter of the pool free keep every other
+    // frame, with nothing free drop the frame (or wait, when rendering offline)
+    if (!capture.offline && queuedFrames(capture.free) < CAPTURE_POOL_SIZE / 4 && capture.frames % 2 == 1)
+    {
+        capture.throttled++;
+        capture.frames++;
+        return;
+    }
+
+    int slot;
+    while (!popFrame(capture.free, slot))
+    {
+        if (!capture.offline)
+        {
+            capture.dropped++;
+            capture.frames++;
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    std::vector<Uint8> &pixels = capture.buffers[slot];
+    Uint64 readStart = SDL_GetPerformanceCounter();
+    if (renderBackend == BACKEND_RASTER)
+    {
+        memcpy(pixels.data(), frame.pixels.data(), pixels.size());
+    }
+    else
+    {
+        SDL_RenderReadPixels(renderer, nullptr, SDL_PIXELFORMAT_RGBA32, pixels.data(), capture.width * 4);
+    }
+    capture.readbackTotalMs += (SDL_GetPerformanceCounter() - readStart) * 1000.0 / SDL_GetPerformanceFrequency();
+
+    capture.timestamps[slot] = capture.offline ? capture.offlineMs : now - capture.startTicks;
+    capture.lastCaptureTicks = now;
+    capture.frames++;
+    pushFrame(capture.filled, slot);
+
+    double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    capture.overheadTotalMs += ms;
+    capture.overheadWorstMs = max(capture.overheadWorstMs, ms);
 }
 
-bool playBackgroundMusic(const char *musicPath)
+void stopCapture()
 {
-    backgroundMusic = Mix_LoadMUS(musicPath);
-    if (backgroundMusic == nullptr)
+    if (!capture.active)
     {
-        cout << "Failed to load background music! SDL_mixer Error: " << Mix_GetError() << endl;
-        return false;
+        return;
     }
 
-    if (Mix_PlayMusic(backgroundMusic, -1) == -1)
+    capture.stopping.store(true, std::memory_order_release);
+    capture.writer.join();
+    capture.active = false;
+
+    fclose(capture.video);
+    capture.video = nullptr;
+    if (capture.index != nullptr)
     {
-        cout << "Failed to play background music! SDL_mixer Error: " << Mix_GetError() << endl;
-        return false;
+        fclose(capture.index);
+        capture.index = nullptr;
     }
 
-    return true;
+    long kept = capture.frames - capture.dropped - capture.throttled;
+    cout << "Captured " << kept << " of " << capture.frames << " frames (" << capture.dropped << " dropped, "
+         << capture.throttled << " throttled), overhead per frame: "
+         << (kept > 0 ? capture.overheadTotalMs / kept : 0.0) << " ms average ("
+         << (kept > 0 ? capture.readbackTotalMs / kept : 0.0) << " ms "
+         << (renderBackend == BACKEND_RASTER ? "framebuffer copy" : "SDL_RenderReadPixels") << "), "
+         << capture.overheadWorstMs << " ms worst" << endl;
+    if (capture.y4m)
+    {
+        cout << "Y4M timeline at " << 1000 / CAPTURE_FRAME_MS << " fps: " << capture.repeated
+             << " frames repeated over gaps, " << capture.skipped << " early frames skipped" << endl;
+    }
 }
 
-void renderStartButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor)
+// Binary files start with "SNKT", a 32-bit version, then the 64-bit counter
+// frequency and start value; records follow as TelemetryEvent verbatim.
+const Uint32 TELEMETRY_VERSION = 1;
+const int TELEMETRY_KEEP_FILES = 4;
+
+struct TelemetryKind
 {
-    SDL_Rect startRect = {x, y, width, height};
-    SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
-    SDL_RenderFillRect(renderer, &startRect);
-    renderText(renderer, "Start Game", x + 30, y + 10, textColor);
-}
+    const char *name, *a, *b;
+};
 
-void renderExitButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor)
+const TelemetryKind telemetryKinds[TELEMETRY_TYPE_COUNT] = {
+    {"game_start", "level", "seed"},
+    {"tick", "length", "duration_ns"},
+    {"eat", "score", "length"},
+    {"bonus_spawn", "x", "y"},
+    {"bonus_eat", "score", nullptr},
+    {"collision", "kind", "score"},
+    {"restart", "score", nullptr},
+    {"quit", "scene", "score"}};
+
+const char *const collisionNames[] = {"none", "wall", "self", "obstacle"};
+
+struct Telemetry
 {
-    SDL_Rect exitRect = {x, y, width, height};
-    SDL_SetRenderDrawColor(renderer, 139, 0, 0, 255);
-    SDL_RenderFillRect(renderer, &exitRect);
-    renderText(renderer, "Exit Game", x + 30, y + 10, textColor);
-}
+    std::atomic<bool> active{false};
+    bool ndjson = false;
+    string path;
+    FILE *file = nullptr;
+    long long fileBytes = 0, rotateBytes = 0;
+    Uint64 startCounter = 0, frequency = 1;
+    std::mutex ringsLock; // guards rings and flushing; never held while writing
+    std::vector<TelemetryRing *> rings;
+    std::vector<TelemetryRing *> draining; // the flush thread's copy of rings
+    bool flushing = false;                 // a flush thread owns draining and freeing the rings
+    Uint16 nextThread = 0;
+    Uint64 retiredDropped = 0;
+    std::thread flusher;
+    std::atomic<bool> stopping{false};
+    long long written = 0;
+    int rotations = 0;
+};
 
-void renderGameOverButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor)
+Telemetry telemetry;
+thread_local TelemetryRing *telemetryRing = nullptr;
+
+// Called with ringsLock held
+void freeTelemetryRing(TelemetryRing *ring)
 {
-    SDL_Rect gameOverRect = {x, y, width, height};
-    SDL_SetRenderDrawColor(renderer, 128, 128, 128, 255);
-    SDL_RenderFillRect(renderer, &gameOverRect);
-    gameOverRenderText(renderer, "Game Over", x + 30, y + 10, textColor);
+    telemetry.retiredDropped += ring->dropped.load(std::memory_order_relaxed);
+    telemetry.rings.erase(find(telemetry.rings.begin(), telemetry.rings.end(), ring));
+    delete ring;
 }
 
-void renderRestartButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor)
+// Hands the thread's ring back when the thread exits: to the flush thread,
+// which frees it once drained, or straight back when none is running
+struct TelemetryThreadExit
 {
-    SDL_Rect restartRect = {x, y, width, height};
-    SDL_SetRenderDrawColor(renderer, 0, 200, 0, 255);
-    SDL_RenderFillRect(renderer, &restartRect);
-    renderText(renderer, "Restart Game", x + 30, y + 10, textColor);
-}
+    TelemetryRing *ring = nullptr;
 
-bool handleRestartButtonClick(int mouseX, int mouseY, int x, int y, int width, int height)
+    ~TelemetryThreadExit()
+    {
+        if (ring == nullptr)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(telemetry.ringsLock);
+        if (telemetry.flushing)
+        {
+            ring->retired.store(true, std::memory_order_release);
+        }
+        else
+        {
+            freeTelemetryRing(ring);
+        }
+        telemetryRing = nullptr;
+    }
+};
+
+thread_local TelemetryThreadExit telemetryThreadExit;
+
+TelemetryRing *registerTelemetryThread()
 {
-    return (mouseX > x && mouseX < x + width && mouseY > y && mouseY < y + height);
+    TelemetryRing *ring = new TelemetryRing();
+    std::lock_guard<std::mutex> lock(telemetry.ringsLock);
+    ring->thread = telemetry.nextThread++;
+    telemetry.rings.push_back(ring);
+    telemetryRing = ring;
+    telemetryThreadExit.ring = ring;
+    return ring;
 }
 
-bool handleGameOverButtonClick(int mouseX, int mouseY, int x, int y, int width, int height)
+void emitTelemetry(TelemetryType type, Sint32 a, Sint64 b)
 {
-    return (mouseX > x && mouseX < x + width && mouseY > y && mouseY < y + height);
+    if (!telemetry.active.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    TelemetryRing *ring = telemetryRing != nullptr ? telemetryRing : registerTelemetryThread();
+    unsigned tail = ring->tail.load(std::memory_order_relaxed);
+    if (tail - ring->head.load(std::memory_order_acquire) == TelemetryRing::CAPACITY)
+    {
+        ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    TelemetryEvent &event = ring->events[tail % TelemetryRing::CAPACITY];
+    event.time = SDL_GetPerformanceCounter();
+    event.type = (Uint16)type;
+    event.thread = ring->thread;
+    event.a = a;
+    event.b = b;
+    ring->tail.store(tail + 1, std::memory_order_release);
 }
 
-bool handleStartButtonClick(int mouseX, int mouseY, int x, int y, int width, int height)
+bool openTelemetryFile()
 {
-    return (mouseX > x && mouseX < x + width && mouseY > y && mouseY < y + height);
+    telemetry.file = fopen(telemetry.path.c_str(), telemetry.ndjson ? "w" : "wb");
+    if (telemetry.file == nullptr)
+    {
+        cout << "Failed to open telemetry output " << telemetry.path << endl;
+        return false;
+    }
+
+    telemetry.fileBytes = 0;
+    if (!telemetry.ndjson)
+    {
+        fwrite("SNKT", 1, 4, telemetry.file);
+        fwrite(&TELEMETRY_VERSION, sizeof(TELEMETRY_VERSION), 1, telemetry.file);
+        fwrite(&telemetry.frequency, sizeof(telemetry.frequency), 1, telemetry.file);
+        fwrite(&telemetry.startCounter, sizeof(telemetry.startCounter), 1, telemetry.file);
+        telemetry.fileBytes = 24;
+    }
+    return true;
 }
 
-bool handleExitButtonClick(int mouseX, int mouseY, int x, int y, int width, int height)
+// The oldest file is discarded, path.k becomes path.k+1 and path becomes path.1
+void rotateTelemetryFile()
 {
-    return (mouseX > x && mouseX < x + width && mouseY > y && mouseY < y + height);
+    fclose(telemetry.file);
+    remove((telemetry.path + "." + to_string(TELEMETRY_KEEP_FILES)).c_str());
+    for (int k = TELEMETRY_KEEP_FILES - 1; k >= 1; k--)
+    {
+        string from = telemetry.path + "." + to_string(k);
+        string to = telemetry.path + "." + to_string(k + 1);
+        rename(from.c_str(), to.c_str());
+    }
+    rename(telemetry.path.c_str(), (telemetry.path + ".1").c_str());
+    telemetry.rotations++;
+
+    if (!openTelemetryFile())
+    {
+        // Keep draining so the rings do not fill up; the events are lost
+        telemetry.file = fopen(
+#if defined(_WIN32)
+            "NUL",
+#else
+            "/dev/null",
+#endif
+            "wb");
+    }
 }
 
-bool isMouseOverButton(int mouseX, int mouseY, int buttonX, int buttonY, int buttonWidth, int buttonHeight)
+void writeTelemetryEvent(const TelemetryEvent &event)
 {
-    return (mouseX >= buttonX && mouseX <= buttonX + buttonWidth &&
-            mouseY >= buttonY && mouseY <= buttonY + buttonHeight);
+    if (telemetry.fileBytes >= telemetry.rotateBytes)
+    {
+        rotateTelemetryFile();
+    }
+
+    if (!telemetry.ndjson)
+    {
+        fwrite(&event, sizeof(event), 1, telemetry.file);
+        telemetry.fileBytes += sizeof(event);
+        return;
+    }
+
+    const TelemetryKind &kind = telemetryKinds[event.type < TELEMETRY_TYPE_COUNT ? event.type : (Uint16)TELEMETRY_QUIT];
+    long long ns = (long long)((event.time - telemetry.startCounter) * (1e9 / telemetry.frequency));
+    char line[256];
+    int length = snprintf(line, sizeof(line), "{\"t_ns\":%lld,\"thread\":%u,\"event\":\"%s\"", ns, event.thread, kind.name);
+    if (event.type == TELEMETRY_COLLISION)
+    {
+        length += snprintf(line + length, sizeof(line) - length, ",\"%s\":\"%s\"", kind.a, collisionNames[event.a & 3]);
+    }
+    else
+    {
+        length += snprintf(line + length, sizeof(line) - length, ",\"%s\":%d", kind.a, event.a);
+    }
+    if (kind.b != nullptr)
+    {
+        length += snprintf(line + length, sizeof(line) - length, ",\"%s\":%lld", kind.b, (long long)event.b);
+    }
+    length += snprintf(line + length, sizeof(line) - length, "}\n");
+    fwrite(line, 1, length, telemetry.file);
+    telemetry.fileBytes += length;
 }
 
-void drawCircle(SDL_Renderer *renderer, int centerX, int centerY, int radius)
+// Frees the rings of exited threads that have been drained and lists the
+// rest for draining. Only the flush thread frees rings while it runs, so
+// the listed ones stay valid after the lock is released.
+void collectTelemetryRings()
 {
-    for (int w = 0; w < radius * 2; w++)
+    std::lock_guard<std::mutex> lock(telemetry.ringsLock);
+    for (size_t i = telemetry.rings.size(); i-- > 0;)
+    {
+        TelemetryRing *ring = telemetry.rings[i];
+        if (ring->retired.load(std::memory_order_acquire) &&
+            ring->head.load(std::memory_order_relaxed) == ring->tail.load(std::memory_order_acquire))
+        {
+            freeTelemetryRing(ring);
+        }
+    }
+    telemetry.draining.assign(telemetry.rings.begin(), telemetry.rings.end());
+}
+
+// Moves everything currently queued in any ring to the file
+size_t drainTelemetry()
+{
+    size_t drained = 0;
+    collectTelemetryRings();
+    for (TelemetryRing *ring : telemetry.draining)
+    {
+        unsigned head = ring->head.load(std::memory_order_relaxed);
+        unsigned tail = ring->tail.load(std::memory_order_acquire);
+        for (; head != tail; head++)
+        {
+            writeTelemetryEvent(ring->events[head % TelemetryRing::CAPACITY]);
+            drained++;
+        }
+        ring->head.store(head, std::memory_order_release);
+    }
+    telemetry.written += drained;
+    return drained;
+}
+
+void telemetryFlushLoop()
+{
+    while (true)
+    {
+        bool stopping = telemetry.stopping.load(std::memory_order_acquire);
+        size_t drained = drainTelemetry();
+        if (drained > 0)
+        {
+            fflush(telemetry.file);
+        }
+        else if (stopping)
+        {
+            break;
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+}
+
+bool startTelemetry(const char *path, long long rotateBytes)
+{
+    size_t length = strlen(path);
+    telemetry.ndjson = (length >= 7 && strcmp(path + length - 7, ".ndjson") == 0) ||
+                       (length >= 6 && strcmp(path + length - 6, ".jsonl") == 0);
+    telemetry.path = path;
+    telemetry.rotateBytes = rotateBytes;
+    telemetry.written = 0;
+    telemetry.rotations = 0;
+    telemetry.frequency = SDL_GetPerformanceFrequency();
+    telemetry.startCounter = SDL_GetPerformanceCounter();
+    if (!openTelemetryFile())
+    {
+        return false;
+    }
+
+    if (telemetryRing == nullptr)
+    {
+        registerTelemetryThread(); // so the game thread never allocates on emit
+    }
+    telemetry.stopping = false;
+    {
+        std::lock_guard<std::mutex> lock(telemetry.ringsLock);
+        telemetry.flushing = true;
+    }
+    telemetry.flusher = std::thread(telemetryFlushLoop);
+    telemetry.active = true;
+    return true;
+}
+
+void stopTelemetry()
+{
+    if (!telemetry.active)
+    {
+        return;
+    }
+
+    telemetry.active = false;
+    telemetry.stopping.store(true, std::memory_order_release);
+    telemetry.flusher.join();
+    fclose(telemetry.file);
+    telemetry.file = nullptr;
+
+    // Everything is drained, so exited threads' rings can go now
+    collectTelemetryRings();
+    std::lock_guard<std::mutex> lock(telemetry.ringsLock);
+    telemetry.flushing = false;
+    Uint64 dropped = telemetry.retiredDropped;
+    for (TelemetryRing *ring : telemetry.rings)
+    {
+        dropped += ring->dropped.load(std::memory_order_relaxed);
+    }
+    cout << "Telemetry: " << telemetry.written << " events written, " << dropped << " dropped, "
+         << telemetry.rotations << " rotations" << endl;
+}
+
+const char *allocationNames[ALLOC_SUBSYSTEMS] = {"other", "simulation", "effects", "render", "text", "audio", "overlay"};
+const char *sceneNames[] = {"menu", "playing", "paused", "game_over", "final_score", "quit"};
+
+struct AllocationCounters
+{
+    std::atomic<Uint64> count[ALLOC_SUBSYSTEMS];
+    std::atomic<Uint64> bytes[ALLOC_SUBSYSTEMS];
+};
+
+struct Allocations
+{
+    AllocationFrame last;   // the frame that just ended
+    AllocationFrame totals; // every frame so far
+    Uint64 frames = 0;
+    Uint64 framesAllocating = 0;
+    Uint64 peakCount = 0;
+    FILE *log = nullptr;
+    bool overlay = false;
+};
+
+// Left to static zero-initialization, so counting works before main
+AllocationCounters allocationCounters;
+Allocations allocations;
+thread_local AllocationSubsystem allocationSubsystem = ALLOC_OTHER;
+SDL_malloc_func sdlMalloc = nullptr;
+SDL_calloc_func sdlCalloc = nullptr;
+SDL_realloc_func sdlRealloc = nullptr;
+SDL_free_func sdlFree = nullptr;
+
+#if defined(SNAKE_ALLOC_STATS)
+inline void countAllocation(size_t size)
+{
+    allocationCounters.count[allocationSubsystem].fetch_add(1, std::memory_order_relaxed);
+    allocationCounters.bytes[allocationSubsystem].fetch_add(size, std::memory_order_relaxed);
+}
+
+void *alignedAllocate(size_t size, size_t alignment)
+{
+#if defined(_WIN32)
+    return _aligned_malloc(size, alignment);
+#else
+    void *block = nullptr;
+    return posix_memalign(&block, max(alignment, sizeof(void *)), size) == 0 ? block : nullptr;
+#endif
+}
+
+void alignedFree(void *block)
+{
+#if defined(_WIN32)
+    _aligned_free(block);
+#else
+    free(block);
+#endif
+}
+
+// Replacement operators may not be inline. GCC would otherwise inline them
+// here and then see the free() in delete paired with its own operator new.
+#if defined(__GNUC__)
+#define REPLACEMENT_FUNCTION __attribute__((noinline))
+#else
+#define REPLACEMENT_FUNCTION
+#endif
+
+REPLACEMENT_FUNCTION void *operator new(size_t size)
+{
+    countAllocation(size);
+    void *block = malloc(size != 0 ? size : 1);
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+REPLACEMENT_FUNCTION void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+REPLACEMENT_FUNCTION void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    countAllocation(size);
+    return malloc(size != 0 ? size : 1);
+}
+
+REPLACEMENT_FUNCTION void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+REPLACEMENT_FUNCTION void *operator new(size_t size, std::align_val_t alignment)
+{
+    countAllocation(size);
+    void *block = alignedAllocate(size != 0 ? size : 1, (size_t)alignment);
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+REPLACEMENT_FUNCTION void *operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+REPLACEMENT_FUNCTION void operator delete(void *block) noexcept
+{
+    free(block);
+}
+
+REPLACEMENT_FUNCTION void operator delete[](void *block) noexcept
+{
+    free(block);
+}
+
+REPLACEMENT_FUNCTION void operator delete(void *block, size_t) noexcept
+{
+    operator delete(block);
+}
+
+REPLACEMENT_FUNCTION void operator delete[](void *block, size_t) noexcept
+{
+    operator delete[](block);
+}
+
+REPLACEMENT_FUNCTION void operator delete(void *block, std::align_val_t) noexcept
+{
+    alignedFree(block);
+}
+
+REPLACEMENT_FUNCTION void operator delete[](void *block, std::align_val_t) noexcept
+{
+    alignedFree(block);
+}
+
+REPLACEMENT_FUNCTION void operator delete(void *block, size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(block, alignment);
+}
+
+REPLACEMENT_FUNCTION void operator delete[](void *block, size_t, std::align_val_t alignment) noexcept
+{
+    operator delete[](block, alignment);
+}
+
+void *SDLCALL countedMalloc(size_t size)
+{
+    countAllocation(size);
+    return sdlMalloc(size);
+}
+
+void *SDLCALL countedCalloc(size_t count, size_t size)
+{
+    countAllocation(count * size);
+    return sdlCalloc(count, size);
+}
+
+// Counts a fresh or moved block; shrinking or growing in place is not a new
+// allocation
+void *SDLCALL countedRealloc(void *block, size_t size)
+{
+    void *resized = sdlRealloc(block, size);
+    if (resized != nullptr && resized != block)
+    {
+        countAllocation(size);
+    }
+    return resized;
+}
+
+void SDLCALL countedFree(void *block)
+{
+    sdlFree(block);
+}
+
+// Must run before anything is allocated through SDL, since blocks have to
+// be freed by the allocator that made them
+void hookAllocator()
+{
+    SDL_GetMemoryFunctions(&sdlMalloc, &sdlCalloc, &sdlRealloc, &sdlFree);
+    if (SDL_SetMemoryFunctions(countedMalloc, countedCalloc, countedRealloc, countedFree) != 0)
+    {
+        cout << "Could not hook the SDL allocator! SDL Error: " << SDL_GetError() << endl;
+    }
+}
+#else
+void hookAllocator()
+{
+}
+#endif
+
+bool startAllocationLog(const char *path)
+{
+    allocations.log = fopen(path, "w");
+    if (allocations.log == nullptr)
+    {
+        cout << "Could not open allocation log " << path << endl;
+        return false;
+    }
+
+    fprintf(allocations.log, "frame,scene,count,bytes");
+    for (int s = 0; s < ALLOC_SUBSYSTEMS; s++)
+    {
+        fprintf(allocations.log, ",%s_count,%s_bytes", allocationNames[s], allocationNames[s]);
+    }
+    fprintf(allocations.log, "\n");
+    return true;
+}
+
+// Closes the frame: moves the running counts into allocations.last, adds them
+// to the totals and logs them. Returns the frame.
+const AllocationFrame &endAllocationFrame(const char *label)
+{
+    AllocationFrame &frame = allocations.last;
+    frame.totalCount = 0;
+    frame.totalBytes = 0;
+    for (int s = 0; s < ALLOC_SUBSYSTEMS; s++)
+    {
+        frame.count[s] = allocationCounters.count[s].exchange(0, std::memory_order_relaxed);
+        frame.bytes[s] = allocationCounters.bytes[s].exchange(0, std::memory_order_relaxed);
+        frame.totalCount += frame.count[s];
+        frame.totalBytes += frame.bytes[s];
+        allocations.totals.count[s] += frame.count[s];
+        allocations.totals.bytes[s] += frame.bytes[s];
+    }
+    allocations.totals.totalCount += frame.totalCount;
+    allocations.totals.totalBytes += frame.totalBytes;
+    allocations.frames++;
+    allocations.framesAllocating += frame.totalCount > 0;
+    allocations.peakCount = max(allocations.peakCount, frame.totalCount);
+
+    if (allocations.log != nullptr)
+    {
+        fprintf(allocations.log, "%llu,%s,%llu,%llu", (unsigned long long)allocations.frames, label,
+                (unsigned long long)frame.totalCount, (unsigned long long)frame.totalBytes);
+        for (int s = 0; s < ALLOC_SUBSYSTEMS; s++)
+        {
+            fprintf(allocations.log, ",%llu,%llu", (unsigned long long)frame.count[s], (unsigned long long)frame.bytes[s]);
+        }
+        fprintf(allocations.log, "\n");
+    }
+    return frame;
+}
+
+// Drops whatever was counted since the last frame, e.g. loading
+void resetAllocationFrame()
+{
+    for (int s = 0; s < ALLOC_SUBSYSTEMS; s++)
+    {
+        allocationCounters.count[s].store(0, std::memory_order_relaxed);
+        allocationCounters.bytes[s].store(0, std::memory_order_relaxed);
+    }
+}
+
+void stopAllocationLog()
+{
+    if (allocations.log != nullptr)
+    {
+        fclose(allocations.log);
+        allocations.log = nullptr;
+    }
+}
+
+void reportAllocations()
+{
+    if (!allocationCounting || allocations.frames == 0)
+    {
+        return;
+    }
+    const AllocationFrame &totals = allocations.totals;
+    cout << "Allocations: " << (double)totals.totalCount / allocations.frames << " per frame ("
+         << (double)totals.totalBytes / allocations.frames << " bytes), peak " << allocations.peakCount << ", "
+         << allocations.framesAllocating << " of " << allocations.frames << " frames allocating;";
+    for (int s = 0; s < ALLOC_SUBSYSTEMS; s++)
+    {
+        cout << " " << allocationNames[s] << " " << totals.count[s];
+    }
+    cout << endl;
+}
+
+// Maps a whole file read-only, or returns nullptr if it cannot be opened or
+// is shorter than minimumSize
+void *mapFile(const string &path, size_t minimumSize, size_t &size)
+{
+    void *view = nullptr;
+    size = 0;
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER fileSize;
+        HANDLE fileMapping = nullptr;
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= (LONGLONG)max(minimumSize, (size_t)1))
+        {
+            size = (size_t)fileSize.QuadPart;
+            fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        }
+        if (fileMapping != nullptr)
+        {
+            view = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(fileMapping);
+        }
+        CloseHandle(file);
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size >= (off_t)max(minimumSize, (size_t)1))
+    {
+        size = info.st_size;
+        view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED)
+        {
+            view = nullptr;
+        }
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+#endif
+    return view;
+}
+
+void unmapFile(void *view, size_t size)
+{
+    if (view == nullptr)
+    {
+        return;
+    }
+#if defined(_WIN32)
+    (void)size;
+    UnmapViewOfFile(view);
+#else
+    munmap(view, size);
+#endif
+}
+
+vector<Level> levels;
+size_t currentLevel = 0;
+string levelsDirectory = "levels";
+
+inline bool levelCellSet(const Uint8 *bits, Uint32 rowBytes, int col, int row)
+{
+    return (bits[(size_t)row * rowBytes + (col >> 3)] >> (col & 7)) & 1;
+}
+
+bool parseLevelSource(LevelSource &source, const string &path)
+{
+    ifstream in(path);
+    if (!in)
+    {
+        cout << "Failed to open level " << path << endl;
+        return false;
+    }
+
+    source.name = filesystem::path(path).stem().string();
+    string line;
+    int lineNumber = 0;
+    while (getline(in, line))
+    {
+        lineNumber++;
+        istringstream words(line.substr(0, line.find('#')));
+        string keyword;
+        if (!(words >> keyword))
+        {
+            continue;
+        }
+
+        bool ok = true;
+        if (keyword == "name")
+        {
+            ok = (bool)(words >> source.name);
+        }
+        else if (keyword == "size")
+        {
+            ok = (bool)(words >> source.width >> source.height);
+        }
+        else if (keyword == "field" || keyword == "wall" || keyword == "obstacle")
+        {
+            SDL_Rect rect;
+            ok = (bool)(words >> rect.x >> rect.y >> rect.w >> rect.h) && rect.w > 0 && rect.h > 0;
+            if (keyword == "field")
+                source.field = rect;
+            else
+                (keyword == "wall" ? source.walls : source.obstacles).push_back(rect);
+        }
+        else if (keyword == "spawn")
+        {
+            LevelSpawn spawn = {0, 0, 1, 0};
+            string facing = "right";
+            ok = (bool)(words >> spawn.x >> spawn.y);
+            words >> facing;
+            spawn.dirX = facing == "right" ? 1 : facing == "left" ? -1 : 0;
+            spawn.dirY = facing == "down" ? 1 : facing == "up" ? -1 : 0;
+            ok = ok && (spawn.dirX != 0 || spawn.dirY != 0);
+            source.spawns.push_back(spawn);
+        }
+        else if (keyword == "map")
+        {
+            // The grid follows the size directive, so it knows its row count
+            source.map.resize(source.height / SNAKE_VELOCITY);
+            for (string &row : source.map)
+            {
+                lineNumber++;
+                ok = ok && (bool)getline(in, row);
+            }
+        }
+        else
+        {
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            cout << path << ":" << lineNumber << ": bad level directive" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Builds the SNKL image for source into image (Uint64 so sections stay
+// aligned), reporting problems by source name. bindLevel repeats the checks
+// the game depends on, since a .snkl file may not have come from here.
+bool compileLevel(const LevelSource &source, vector<Uint64> &image)
+{
+    const int cell = SNAKE_VELOCITY;
+    if (source.width <= 0 || source.height <= 0 || source.width % cell != 0 || source.height % cell != 0)
+    {
+        cout << "Level " << source.name << ": size must be a positive multiple of " << cell << endl;
+        return false;
+    }
+
+    const int cols = source.width / cell;
+    const int rows = source.height / cell;
+    const Uint32 rowBytes = (cols + 7) / 8;
+    vector<Uint8> wallBits((size_t)rows * rowBytes), obstacleBits((size_t)rows * rowBytes);
+    vector<SDL_Rect> walls = source.walls, obstacles = source.obstacles;
+    vector<LevelSpawn> spawns = source.spawns;
+
+    auto setCell = [&](vector<Uint8> &bits, int col, int row) {
+        bits[(size_t)row * rowBytes + (col >> 3)] |= 1 << (col & 7);
+    };
+
+    for (const SDL_Rect &wall : walls)
+    {
+        for (int row = max(0, wall.y / cell); row <= min(rows - 1, (wall.y + wall.h - 1) / cell); row++)
+        {
+            for (int col = max(0, wall.x / cell); col <= min(cols - 1, (wall.x + wall.w - 1) / cell); col++)
+            {
+                int centerX = col * cell + cell / 2, centerY = row * cell + cell / 2;
+                if (centerX >= wall.x && centerX < wall.x + wall.w && centerY >= wall.y && centerY < wall.y + wall.h)
+                {
+                    setCell(wallBits, col, row);
+                }
+            }
+        }
+    }
+
+    for (const SDL_Rect &obstacle : obstacles)
+    {
+        for (int row = max(0, obstacle.y / cell); row <= min(rows - 1, (obstacle.y + obstacle.h - 1) / cell); row++)
+        {
+            for (int col = max(0, obstacle.x / cell); col <= min(cols - 1, (obstacle.x + obstacle.w - 1) / cell); col++)
+            {
+                setCell(obstacleBits, col, row);
+            }
+        }
+    }
+
+    // Map cells go into the bitmaps directly; each horizontal run becomes
+    // one rect so drawing a maze stays a handful of fills per row.
+    for (int row = 0; row < (int)source.map.size(); row++)
+    {
+        const string &line = source.map[row];
+        for (int col = 0; col < cols && col < (int)line.size();)
+        {
+            char c = line[col];
+            int end = col + 1;
+            if (c == '#' || c == 'X')
+            {
+                while (end < cols && end < (int)line.size() && line[end] == c)
+                {
+                    end++;
+                }
+                for (int i = col; i < end; i++)
+                {
+                    setCell(c == '#' ? wallBits : obstacleBits, i, row);
+                }
+                (c == '#' ? walls : obstacles).push_back({col * cell, row * cell, (end - col) * cell, cell});
+            }
+            else if (c == '@')
+            {
+                spawns.push_back({col * cell, row * cell, 1, 0});
+            }
+            col = end;
+        }
+    }
+
+    // Rects are clipped to the board, which bindLevel insists on
+    const SDL_Rect board = {0, 0, source.width, source.height};
+    for (vector<SDL_Rect> *rects : {&walls, &obstacles})
+    {
+        vector<SDL_Rect> clipped;
+        for (const SDL_Rect &rect : *rects)
+        {
+            SDL_Rect inside;
+            if (SDL_IntersectRect(&rect, &board, &inside))
+            {
+                clipped.push_back(inside);
+            }
+        }
+        rects->swap(clipped);
+    }
+
+    if (spawns.empty())
+    {
+        spawns.push_back({source.width / 2 / cell * cell, source.height / 2 / cell * cell, 1, 0});
+    }
+    for (const LevelSpawn &spawn : spawns)
+    {
+        if (spawn.x % cell != 0 || spawn.y % cell != 0 || spawn.x < 0 || spawn.y < 0 || spawn.x >= source.width ||
+            spawn.y >= source.height || levelCellSet(wallBits.data(), rowBytes, spawn.x / cell, spawn.y / cell))
+        {
+            cout << "Level " << source.name << ": spawn " << spawn.x << "," << spawn.y << " is not an open cell" << endl;
+            return false;
+        }
+    }
+
+    SDL_Rect field = source.field.w > 0 ? source.field : SDL_Rect{0, 0, source.width, source.height};
+    bool fieldOpen = false;
+    if (field.x >= 0 && field.y >= 0 && field.x % cell == 0 && field.y % cell == 0 && field.w >= cell &&
+        field.h >= cell && field.w > 2 * BONUS_FOOD_RADIUS && field.h > 2 * BONUS_FOOD_RADIUS &&
+        field.x + field.w <= source.width && field.y + field.h <= source.height)
+    {
+        // spawnFood retries until it misses a wall, so it needs somewhere to land
+        for (int row = field.y / cell; !fieldOpen && row < (field.y + field.h) / cell; row++)
+        {
+            for (int col = field.x / cell; !fieldOpen && col < (field.x + field.w) / cell; col++)
+            {
+                fieldOpen = !levelCellSet(wallBits.data(), rowBytes, col, row);
+            }
+        }
+    }
+    if (!fieldOpen)
+    {
+        cout << "Level " << source.name << ": field must be a cell-aligned area of the board with an open cell" << endl;
+        return false;
+    }
+
+    auto align = [](Uint64 offset) { return (offset + 7) & ~(Uint64)7; };
+    Uint64 spawnOffset = align(sizeof(LevelHeader));
+    Uint64 wallOffset = align(spawnOffset + spawns.size() * sizeof(LevelSpawn));
+    Uint64 obstacleOffset = align(wallOffset + walls.size() * sizeof(SDL_Rect));
+    Uint64 wallBitsOffset = align(obstacleOffset + obstacles.size() * sizeof(SDL_Rect));
+    Uint64 obstacleBitsOffset = align(wallBitsOffset + wallBits.size());
+    Uint64 fileSize = align(obstacleBitsOffset + obstacleBits.size());
+    if (fileSize > UINT32_MAX)
+    {
+        cout << "Level " << source.name << ": compiled level is larger than 4 GB" << endl;
+        return false;
+    }
+
+    image.assign(fileSize / 8, 0);
+    Uint8 *bytes = (Uint8 *)image.data();
+    LevelHeader *header = (LevelHeader *)bytes;
+    memcpy(header->magic, "SNKL", 4);
+    header->version = LEVEL_VERSION;
+    strncpy(header->name, source.name.c_str(), LEVEL_NAME_LENGTH - 1);
+    header->width = source.width;
+    header->height = source.height;
+    header->cols = cols;
+    header->rows = rows;
+    header->rowBytes = rowBytes;
+    header->field = field;
+    header->spawnCount = spawns.size();
+    header->wallCount = walls.size();
+    header->obstacleCount = obstacles.size();
+    header->spawnOffset = spawnOffset;
+    header->wallOffset = wallOffset;
+    header->obstacleOffset = obstacleOffset;
+    header->wallBitsOffset = wallBitsOffset;
+    header->obstacleBitsOffset = obstacleBitsOffset;
+    header->fileSize = fileSize;
+
+    memcpy(bytes + spawnOffset, spawns.data(), spawns.size() * sizeof(LevelSpawn));
+    memcpy(bytes + wallOffset, walls.data(), walls.size() * sizeof(SDL_Rect));
+    memcpy(bytes + obstacleOffset, obstacles.data(), obstacles.size() * sizeof(SDL_Rect));
+    memcpy(bytes + wallBitsOffset, wallBits.data(), wallBits.size());
+    memcpy(bytes + obstacleBitsOffset, obstacleBits.data(), obstacleBits.size());
+    return true;
+}
+
+// Points level into a compiled image after checking everything the game
+// relies on: the header's sizes and offsets against the image's size, a
+// field the food spawners can draw from, rects on the board and spawns on
+// open cells. The bitmaps are only probed (the field until its first open
+// cell), so large boards still bind at once.
+bool bindLevel(Level &level, const Uint8 *bytes, size_t size, const string &origin)
+{
+    const LevelHeader *header = (const LevelHeader *)bytes;
+    auto fits = [&](Uint64 offset, Uint64 count, Uint64 itemSize) {
+        return offset % 8 == 0 && offset <= size && count * itemSize <= size - offset;
+    };
+
+    if (size < sizeof(LevelHeader) || memcmp(header->magic, "SNKL", 4) != 0 || header->version != LEVEL_VERSION ||
+        header->fileSize != size || header->name[LEVEL_NAME_LENGTH - 1] != '\0' || header->cols <= 0 ||
+        header->rows <= 0 || header->cols > INT_MAX / SNAKE_VELOCITY || header->rows > INT_MAX / SNAKE_VELOCITY ||
+        header->cols * SNAKE_VELOCITY != header->width || header->rows * SNAKE_VELOCITY != header->height ||
+        header->rowBytes < (Uint32)(header->cols + 7) / 8 || header->spawnCount == 0 ||
+        !fits(header->spawnOffset, header->spawnCount, sizeof(LevelSpawn)) ||
+        !fits(header->wallOffset, header->wallCount, sizeof(SDL_Rect)) ||
+        !fits(header->obstacleOffset, header->obstacleCount, sizeof(SDL_Rect)) ||
+        !fits(header->wallBitsOffset, header->rows, header->rowBytes) ||
+        !fits(header->obstacleBitsOffset, header->rows, header->rowBytes))
+    {
+        cout << "Not a compiled level (or from another version): " << origin << endl;
+        return false;
+    }
+
+    const Uint8 *wallBits = bytes + header->wallBitsOffset;
+    auto openCell = [&](Sint64 x, Sint64 y) {
+        return x >= 0 && y >= 0 && x < header->width && y < header->height && x % SNAKE_VELOCITY == 0 &&
+               y % SNAKE_VELOCITY == 0 &&
+               !levelCellSet(wallBits, header->rowBytes, (int)(x / SNAKE_VELOCITY), (int)(y / SNAKE_VELOCITY));
+    };
+
+    // randomOpenCell draws from the field's cells and spawnBonusFood from
+    // inside its margin, and both divide by those extents
+    const SDL_Rect &field = header->field;
+    bool fieldOpen = false;
+    if (field.x >= 0 && field.y >= 0 && field.x % SNAKE_VELOCITY == 0 && field.y % SNAKE_VELOCITY == 0 &&
+        field.w >= SNAKE_VELOCITY && field.h >= SNAKE_VELOCITY && field.w > 2 * BONUS_FOOD_RADIUS &&
+        field.h > 2 * BONUS_FOOD_RADIUS && (Sint64)field.x + field.w <= header->width &&
+        (Sint64)field.y + field.h <= header->height)
+    {
+        for (int y = field.y; !fieldOpen && y + SNAKE_VELOCITY <= field.y + field.h; y += SNAKE_VELOCITY)
+        {
+            for (int x = field.x; !fieldOpen && x + SNAKE_VELOCITY <= field.x + field.w; x += SNAKE_VELOCITY)
+            {
+                fieldOpen = openCell(x, y);
+            }
+        }
+    }
+    if (!fieldOpen)
+    {
+        cout << "Level " << origin << ": field is not a cell-aligned area of the board with an open cell" << endl;
+        return false;
+    }
+
+    // Drawing trusts the rects to lie on the board
+    const SDL_Rect *walls = (const SDL_Rect *)(bytes + header->wallOffset);
+    const SDL_Rect *obstacles = (const SDL_Rect *)(bytes + header->obstacleOffset);
+    auto onBoard = [&](const SDL_Rect *rects, Uint32 count) {
+        for (Uint32 i = 0; i < count; i++)
+        {
+            const SDL_Rect &r = rects[i];
+            if (r.x < 0 || r.y < 0 || r.w <= 0 || r.h <= 0 || (Sint64)r.x + r.w > header->width ||
+                (Sint64)r.y + r.h > header->height)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    if (!onBoard(walls, header->wallCount) || !onBoard(obstacles, header->obstacleCount))
+    {
+        cout << "Level " << origin << ": a wall or obstacle lies outside the board" << endl;
+        return false;
+    }
+
+    const LevelSpawn *spawns = (const LevelSpawn *)(bytes + header->spawnOffset);
+    for (Uint32 i = 0; i < header->spawnCount; i++)
+    {
+        const LevelSpawn &spawn = spawns[i];
+        bool facing = (spawn.dirY == 0 && (spawn.dirX == 1 || spawn.dirX == -1)) ||
+                      (spawn.dirX == 0 && (spawn.dirY == 1 || spawn.dirY == -1));
+        if (!openCell(spawn.x, spawn.y) || !facing)
+        {
+            cout << "Level " << origin << ": spawn " << i << " is not an open cell facing along an axis" << endl;
+            return false;
+        }
+    }
+
+    level.header = header;
+    level.spawns = spawns;
+    level.walls = walls;
+    level.obstacles = obstacles;
+    level.wallBits = wallBits;
+    level.obstacleBits = bytes + header->obstacleBitsOffset;
+    return true;
+}
+
+bool buildLevel(Level &level, const LevelSource &source)
+{
+    if (!compileLevel(source, level.data))
+    {
+        return false;
+    }
+    return bindLevel(level, (const Uint8 *)level.data.data(), level.data.size() * 8, source.name);
+}
+
+bool writeLevel(const vector<Uint64> &image, const string &path)
+{
+    ofstream out(path, ios::binary);
+    out.write((const char *)image.data(), image.size() * 8);
+    if (!out)
+    {
+        cout << "Failed to write level " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+bool compileLevelFile(const string &sourcePath, const string &outputPath)
+{
+    LevelSource source;
+    vector<Uint64> image;
+    if (!parseLevelSource(source, sourcePath) || !compileLevel(source, image) || !writeLevel(image, outputPath))
+    {
+        return false;
+    }
+    cout << "Compiled " << sourcePath << " -> " << outputPath << endl;
+    return true;
+}
+
+void freeLevel(Level &level)
+{
+    unmapFile(level.mapping, level.mappingSize);
+    level = Level();
+}
+
+// Maps a compiled level read-only. Pages are faulted in as the game touches
+// them, so start-up cost does not grow with the size of the board.
+bool mapLevel(Level &level, const string &path)
+{
+    size_t size = 0;
+    void *view = mapFile(path, sizeof(LevelHeader), size);
+    if (view == nullptr)
+    {
+        cout << "Failed to map level " << path << endl;
+        return false;
+    }
+
+    level.mapping = view;
+    level.mappingSize = size;
+    if (!bindLevel(level, (const Uint8 *)view, size, path))
+    {
+        freeLevel(level);
+        return false;
+    }
+    return true;
+}
+
+int findLevel(const char *name)
+{
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        if (strcmp(levels[i].header->name, name) == 0)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// Compiles every .lvl in dir to a .snkl next to it. With onlyStale set,
+// sources whose .snkl is newer are skipped, so this doubles as the build
+// step the game runs on start-up.
+bool compileLevels(const string &dir, bool onlyStale)
+{
+    error_code error;
+    bool ok = true;
+    for (const filesystem::directory_entry &entry : filesystem::directory_iterator(dir, error))
+    {
+        if (entry.path().extension() != ".lvl")
+        {
+            continue;
+        }
+        filesystem::path compiled = entry.path();
+        compiled.replace_extension(".snkl");
+        if (onlyStale)
+        {
+            error_code missing;
+            filesystem::file_time_type compiledTime = filesystem::last_write_time(compiled, missing);
+            if (!missing && compiledTime >= filesystem::last_write_time(entry.path(), missing) && !missing)
+            {
+                continue;
+            }
+        }
+        ok = compileLevelFile(entry.path().string(), compiled.string()) && ok;
+    }
+    if (error)
+    {
+        cout << "Failed to read level directory " << dir << ": " << error.message() << endl;
+        return false;
+    }
+    return ok;
+}
+
+// Maps every compiled level in dir, in name order. Sources that fail to
+// compile are reported and left out.
+bool loadLevels(const string &dir)
+{
+    compileLevels(dir, true);
+
+    vector<string> paths;
+    error_code error;
+    for (const filesystem::directory_entry &entry : filesystem::directory_iterator(dir, error))
+    {
+        if (entry.path().extension() == ".snkl")
+        {
+            paths.push_back(entry.path().string());
+        }
+    }
+    sort(paths.begin(), paths.end());
+
+    levels.reserve(paths.size());
+    for (const string &path : paths)
+    {
+        levels.emplace_back();
+        if (!mapLevel(levels.back(), path))
+        {
+            levels.pop_back();
+        }
+    }
+
+    if (levels.empty())
+    {
+        cout << "No playable levels in " << dir << endl;
+        return false;
+    }
+    return true;
+}
+
+// Replay recording: "SNKR" and a version byte, then one byte per record.
+// REPLAY_GAME_START is followed by the game's 32-bit little-endian seed,
+// the level name (a length byte, then the characters; version 1 replays
+// have no name and are played on "classic") and a byte of Rule flags
+// (from version 3; older games are played with RULES_CLASSIC); values 0-3
+// are the direction the snake moved on that tick.
+const Uint8 REPLAY_VERSION = 3;
+const Uint8 REPLAY_GAME_START = 0xFF;
+
+FILE *replayFile = nullptr;
+
+Uint8 directionCode(int dirX, int dirY)
+{
+    return dirX == 1 ? 0 : dirX == -1 ? 1 : dirY == 1 ? 2 : 3;
+}
+
+void applyDirectionCode(GameState &game, Uint8 code)
+{
+    const int dirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    game.dirX = dirs[code & 3][0];
+    game.dirY = dirs[code & 3][1];
+}
+
+bool startRecording(const char *path)
+{
+    replayFile = fopen(path, "wb");
+    if (replayFile == nullptr)
+    {
+        cout << "Failed to open replay output " << path << endl;
+        return false;
+    }
+    fwrite("SNKR", 1, 4, replayFile);
+    fputc(REPLAY_VERSION, replayFile);
+    return true;
+}
+
+void recordGameStart(Uint32 seed, const Level &level, Uint32 rules)
+{
+    if (replayFile == nullptr)
+    {
+        return;
+    }
+    Uint8 nameLength = strlen(level.header->name);
+    Uint8 bytes[6] = {REPLAY_GAME_START, (Uint8)seed, (Uint8)(seed >> 8), (Uint8)(seed >> 16), (Uint8)(seed >> 24),
+                      nameLength};
+    fwrite(bytes, 1, sizeof(bytes), replayFile);
+    fwrite(level.header->name, 1, nameLength, replayFile);
+    fputc((Uint8)rules, replayFile);
+}
+
+void recordTick(const GameState &game)
+{
+    if (replayFile != nullptr)
+    {
+        fputc(directionCode(game.dirX, game.dirY), replayFile);
+    }
+}
+
+void stopRecording()
+{
+    if (replayFile != nullptr)
+    {
+        fclose(replayFile);
+        replayFile = nullptr;
+    }
+}
+
+// Drawing entry points used by the game. They forward to SDL_Renderer or to
+// the raster backend depending on renderBackend, which main() picks once.
+void setDrawColor(SDL_Renderer *renderer, Uint8 r, Uint8 g, Uint8 b, Uint8 a)
+{
+    if (renderBackend == BACKEND_RASTER)
+    {
+        frame.color = 0xFF000000 | ((Uint32)b << 16) | ((Uint32)g << 8) | r;
+        return;
+    }
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+}
+
+void clearScreen(SDL_Renderer *renderer)
+{
+    if (renderBackend == BACKEND_RASTER)
+    {
+        rasterFillRect(frame, {0, 0, frame.width, frame.height}, frame.color);
+        return;
+    }
+    SDL_RenderClear(renderer);
+}
+
+void fillRect(SDL_Renderer *renderer, const SDL_Rect *rect)
+{
+    SDL_Rect placed = {rect->x + drawOrigin.x, rect->y + drawOrigin.y, rect->w, rect->h};
+    if (renderBackend == BACKEND_RASTER)
+    {
+        rasterFillRect(frame, placed, frame.color);
+        return;
+    }
+    SDL_RenderFillRect(renderer, &placed);
+}
+
+// Limits drawing to rect, or lifts the limit when rect is null
+void setClipRect(SDL_Renderer *renderer, const SDL_Rect *rect)
+{
+    if (renderBackend == BACKEND_RASTER)
+    {
+        frame.clip = rect ? *rect : SDL_Rect{0, 0, frame.width, frame.height};
+        return;
+    }
+    SDL_RenderSetClipRect(renderer, rect);
+}
+
+void drawPoint(SDL_Renderer *renderer, int x, int y)
+{
+    x += drawOrigin.x;
+    y += drawOrigin.y;
+    if (renderBackend == BACKEND_RASTER)
+    {
+        rasterFillRect(frame, {x, y, 1, 1}, frame.color);
+        return;
+    }
+    SDL_RenderDrawPoint(renderer, x, y);
+}
+
+void drawImage(SDL_Renderer *renderer, const Image &image, const SDL_Rect *dst)
+{
+    SDL_Rect placed;
+    if (dst != nullptr)
+    {
+        placed = {dst->x + drawOrigin.x, dst->y + drawOrigin.y, dst->w, dst->h};
+        dst = &placed;
+    }
+    if (renderBackend == BACKEND_RASTER)
+    {
+        rasterBlit(frame, image.surface, dst);
+        return;
+    }
+    SDL_RenderCopy(renderer, image.texture, nullptr, dst);
+}
+
+void presentFrame(SDL_Renderer *renderer)
+{
+    if (capture.active)
+    {
+        captureFrame(renderer);
+    }
+
+    if (renderBackend == BACKEND_RASTER)
+    {
+        SDL_Surface *windowSurface = window ? SDL_GetWindowSurface(window) : nullptr;
+        if (windowSurface != nullptr)
+        {
+            SDL_BlitSurface(frame.surface, nullptr, windowSurface, nullptr);
+            SDL_UpdateWindowSurface(window);
+        }
+        return;
+    }
+    SDL_RenderPresent(renderer);
+}
+
+// Asset bundle ("SNKA"), built by --pack-assets and mapped at start-up in
+// place of the loose files under Fonts/, audio/ and image/: this header, a
+// table of contents, then every asset ASSET_ALIGNMENT-aligned. Images are
+// stored decoded as SDL_PIXELFORMAT_RGBA32 rows, sound effects as PCM in the
+// mixer format recorded in the header, and fonts and the music stream as
+// their original bytes, which SDL_ttf and SDL_mixer read from memory as is.
+// Assets are found by their loose-file path, so anything missing from the
+// bundle still loads from disk.
+struct AssetBundle
+{
+    const AssetBundleHeader *header = nullptr;
+    const AssetEntry *entries = nullptr;
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+};
+
+AssetBundle assets;
+string assetBundlePath = "assets.snka";
+void unmapAssets()
+{
+    unmapFile(assets.mapping, assets.mappingSize);
+    assets = AssetBundle();
+}
+
+// Leaves assets empty, so everything loads from loose files, when the
+// bundle is missing or fails validation
+bool mapAssets(const string &path)
+{
+    size_t size = 0;
+    void *view = mapFile(path, sizeof(AssetBundleHeader), size);
+    if (view == nullptr)
+    {
+        return false;
+    }
+
+    const AssetBundleHeader *header = (const AssetBundleHeader *)view;
+    const AssetEntry *entries = (const AssetEntry *)(header + 1);
+    bool valid = memcmp(header->magic, "SNKA", 4) == 0 && header->version == ASSET_BUNDLE_VERSION &&
+                 header->fileSize == size && sizeof(*header) + (Uint64)header->count * sizeof(AssetEntry) <= size;
+    for (Uint32 i = 0; valid && i < header->count; i++)
+    {
+        const AssetEntry &entry = entries[i];
+        valid = memchr(entry.name, 0, ASSET_NAME_LENGTH) != nullptr && entry.offset % ASSET_ALIGNMENT == 0 &&
+                entry.offset <= size && entry.size <= size - entry.offset &&
+                (entry.type != ASSET_IMAGE || (entry.width > 0 && entry.height > 0 &&
+                                               (Uint64)entry.width * entry.height * 4 == entry.size));
+    }
+    if (!valid)
+    {
+        cout << "Ignoring invalid asset bundle " << path << endl;
+        unmapFile(view, size);
+        return false;
+    }
+
+    assets.header = header;
+    assets.entries = entries;
+    assets.mapping = view;
+    assets.mappingSize = size;
+    return true;
+}
+
+const AssetEntry *findAsset(const char *path, AssetType type)
+{
+    for (Uint32 i = 0; assets.header != nullptr && i < assets.header->count; i++)
+    {
+        if (assets.entries[i].type == (Uint32)type && strcmp(assets.entries[i].name, path) == 0)
+        {
+            return &assets.entries[i];
+        }
+    }
+    return nullptr;
+}
+
+const Uint8 *assetData(const AssetEntry &entry)
+{
+    return (const Uint8 *)assets.mapping + entry.offset;
+}
+
+TTF_Font *openFont(const char *path, int size)
+{
+    const AssetEntry *entry = findAsset(path, ASSET_FONT);
+    if (entry == nullptr)
+    {
+        return TTF_OpenFont(path, size);
+    }
+    return TTF_OpenFontRW(SDL_RWFromConstMem(assetData(*entry), (int)entry->size), 1, size);
+}
+
+// Bundled PCM is played in place; if the device came up in another format
+// than the bundle was packed for, the samples are converted into a copy
+Mix_Chunk *loadSound(const char *path)
+{
+    const AssetEntry *entry = findAsset(path, ASSET_SOUND);
+    if (entry == nullptr)
+    {
+        return Mix_LoadWAV(path);
+    }
+
+    int frequency = 0, channels = 0;
+    Uint16 format = 0;
+    Mix_QuerySpec(&frequency, &format, &channels);
+    SDL_AudioCVT convert;
+    const AssetBundleHeader &header = *assets.header;
+    int needed = SDL_BuildAudioCVT(&convert, header.audioFormat, (Uint8)header.audioChannels, header.audioFrequency,
+                                   format, (Uint8)channels, frequency);
+    if (needed < 0)
+    {
+        // The device format cannot be reached from the bundle's: decode the loose file
+        cout << "Could not convert bundled " << path << "! SDL Error: " << SDL_GetError() << endl;
+        return Mix_LoadWAV(path);
+    }
+    if (needed == 0)
+    {
+        return Mix_QuickLoad_RAW((Uint8 *)assetData(*entry), (Uint32)entry->size);
+    }
+
+    convert.len = (int)entry->size;
+    convert.buf = (Uint8 *)SDL_malloc((size_t)convert.len * convert.len_mult);
+    if (convert.buf == nullptr)
+    {
+        return nullptr;
+    }
+    memcpy(convert.buf, assetData(*entry), entry->size);
+    if (SDL_ConvertAudio(&convert) < 0)
+    {
+        cout << "Could not convert bundled " << path << "! SDL Error: " << SDL_GetError() << endl;
+        SDL_free(convert.buf);
+        return Mix_LoadWAV(path);
+    }
+    Mix_Chunk *chunk = Mix_QuickLoad_RAW(convert.buf, convert.len_cvt);
+    if (chunk == nullptr)
+    {
+        SDL_free(convert.buf);
+        return nullptr;
+    }
+    chunk->allocated = 1; // Mix_FreeChunk frees the converted copy
+    return chunk;
+}
+
+Mix_Music *loadMusic(const char *path)
+{
+    const AssetEntry *entry = findAsset(path, ASSET_MUSIC);
+    if (entry == nullptr)
+    {
+        return Mix_LoadMUS(path);
+    }
+    return Mix_LoadMUS_RW(SDL_RWFromConstMem(assetData(*entry), (int)entry->size), 1);
+}
+
+// Asks the OS to drop the asset files from the page cache, so the next
+// start-up reads them from disk. Only clean pages go, and only on Linux;
+// elsewhere the cache stays warm.
+void evictAssetsFromCache()
+{
+#if defined(__linux__)
+    vector<string> paths = {assetBundlePath};
+    for (const AssetFile &file : assetFiles)
+    {
+        paths.push_back(file.path);
+    }
+    for (const string &path : paths)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd >= 0)
+        {
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+    }
+#else
+    cout << "Page cache eviction is not supported on this platform; measuring a warm start" << endl;
+#endif
+}
+
+// Returns an RGBA32 surface wrapping the bundle's pixels, or decoded from filePath
+SDL_Surface *loadSurface(const char *filePath)
+{
+    const AssetEntry *entry = findAsset(filePath, ASSET_IMAGE);
+    if (entry != nullptr)
+    {
+        return SDL_CreateRGBSurfaceWithFormatFrom((void *)assetData(*entry), entry->width, entry->height, 32,
+                                                  entry->width * 4, SDL_PIXELFORMAT_RGBA32);
+    }
+
+    SDL_Surface *loaded = IMG_Load(filePath);
+    if (loaded == nullptr)
+    {
+        return nullptr;
+    }
+    SDL_Surface *converted = SDL_ConvertSurfaceFormat(loaded, SDL_PIXELFORMAT_RGBA32, 0);
+    SDL_FreeSurface(loaded);
+    return converted;
+}
+
+// Bundled images need no decoding: the raster backend reads the mapped
+// pixels in place and the SDL backend uploads them to a static texture
+bool loadImage(SDL_Renderer *renderer, Image &image, const char *filePath)
+{
+    if (renderBackend == BACKEND_RASTER)
+    {
+        image.surface = loadSurface(filePath);
+        return image.surface != nullptr;
+    }
+
+    const AssetEntry *entry = findAsset(filePath, ASSET_IMAGE);
+    if (entry != nullptr)
+    {
+        image.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, entry->width,
+                                          entry->height);
+        if (image.texture == nullptr || SDL_UpdateTexture(image.texture, nullptr, assetData(*entry), entry->width * 4) != 0)
+        {
+            return false;
+        }
+        SDL_SetTextureBlendMode(image.texture, SDL_BLENDMODE_BLEND);
+        return true;
+    }
+
+    image.texture = IMG_LoadTexture(renderer, filePath);
+    return image.texture != nullptr;
+}
+
+void freeImage(Image &image)
+{
+    SDL_DestroyTexture(image.texture);
+    image.texture = nullptr;
+
+    SDL_FreeSurface(image.surface);
+    image.surface = nullptr;
+}
+
+bool initializeSDL(SDL_Window *&window, SDL_Renderer *&renderer)
+{
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
+    {
+        cout << "SDL could not initialize! SDL Error: " << SDL_GetError() << endl;
+        return false;
+    }
+
+    if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG))
+    {
+        cout << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << endl;
+        return false;
+    }
+
+    if (Mix_OpenAudio(AUDIO_FREQUENCY, MIX_DEFAULT_FORMAT, AUDIO_CHANNELS, AUDIO_BUFFER_SAMPLES) < 0)
+    {
+        cout << "SDL_mixer could not initialize! SDL_mixer Error: " << Mix_GetError() << endl;
+        return false;
+    }
+
+    if (TTF_Init() == -1)
+    {
+        cout << "SDL_ttf could not initialize! SDL_ttf Error: " << TTF_GetError() << endl;
+        return false;
+    }
+
+    window = SDL_CreateWindow("Snake Game", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+    if (window == nullptr)
+    {
+        cout << "Window could not be created! SDL Error: " << SDL_GetError() << endl;
+        return false;
+    }
+
+    if (renderBackend == BACKEND_RASTER)
+    {
+        resizeFramebuffer(frame, SCREEN_WIDTH, SCREEN_HEIGHT);
+        frame.surface = SDL_CreateRGBSurfaceWithFormatFrom(frame.pixels.data(), frame.width, frame.height, 32,
+                                                           frame.width * 4, SDL_PIXELFORMAT_RGBA32);
+        if (frame.surface == nullptr)
+        {
+            cout << "Framebuffer surface could not be created! SDL Error: " << SDL_GetError() << endl;
+            return false;
+        }
+        SDL_SetSurfaceBlendMode(frame.surface, SDL_BLENDMODE_NONE);
+    }
+    else
+    {
+        renderer = SDL_CreateRenderer(window, -1, rendererFlags);
+        if (renderer == nullptr)
+        {
+            cout << "Renderer could not be created! SDL Error: " << SDL_GetError() << endl;
+            return false;
+        }
+        buildParticleIndices();
+
+        if (dirtyRectMode)
+        {
+            dirtyTarget = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
+            if (dirtyTarget == nullptr)
+            {
+                cout << "Render target could not be created! SDL Error: " << SDL_GetError() << endl;
+                return false;
+            }
+        }
+    }
+
+    font = openFont("Fonts/arial.ttf", 28);
+    if (font == nullptr)
+    {
+        cout << "Failed to load font! SDL_ttf Error: " << TTF_GetError() << endl;
+        return false;
+    }
+
+    score = openFont("Fonts/score.otf", 18);
+    if (score == nullptr)
+    {
+        cout << "Failed to load score font! SDL_ttf Error: " << TTF_GetError() << endl;
+        return false;
+    }
+
+    game_over = openFont("Fonts/game_over.ttf", 28);
+    if (game_over == nullptr)
+    {
+        cout << "Failed to load game over font! SDL_ttf Error: " << TTF_GetError() << endl;
+        return false;
+    }
+
+    finalScore = openFont("Fonts/finalScore.otf", 30);
+    if (finalScore == nullptr)
+    {
+        cout << "Failed to load final score font! SDL_ttf Error: " << TTF_GetError() << endl;
+        return false;
+    }
+
+    eatingSound = loadSound("audio/eating_sound.wav");
+    if (eatingSound == nullptr)
+    {
+        cout << "Failed to load eating sound effect! SDL_mixer Error: " << Mix_GetError() << endl;
+        return false;
+    }
+
+    bonusEatingSound = loadSound("audio/bonus_eating_sound.mp3");
+    if (bonusEatingSound == nullptr)
+    {
+        cout << "Failed to load eating sound effect! SDL_mixer Error: " << Mix_GetError() << endl;
+        return false;
+    }
+
+    gameOverSound = loadSound("audio/game_over_sound.wav");
+    if (gameOverSound == nullptr)
+    {
+        cout << "Failed to load game over sound effect! SDL_mixer Error: " << Mix_GetError() << endl;
+        return false;
+    }
+
+    if (!loadImage(renderer, coverImage, "image/cover_photo.png"))
+    {
+        cout << "Failed to load cover texture! SDL_image Error: " << IMG_GetError() << endl;
+        return false;
+    }
+
+    if (!loadImage(renderer, gameOverScreenImage, "image/game_over_screen.png"))
+    {
+        cout << "Failed to load game over screen texture! SDL_image Error: " << IMG_GetError() << endl;
+        return false;
+    }
+
+    if (!loadImage(renderer, regularFoodImage, "image/normal_fruit.png"))
+    {
+        cout << "Failed to load regular food texture! SDL_image Error: " << IMG_GetError() << endl;
+        return false;
+    }
+
+    if (!loadImage(renderer, bonusFoodImage, "image/bonus_fruit.png"))
+    {
+        cout << "Failed to load bonus food texture! SDL_image Error: " << IMG_GetError() << endl;
+        return false;
+    }
+
+    arrowCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_ARROW);
+    handCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_HAND);
+
+    return true;
+}
+
+// Golden frames draw text as fixed glyph boxes instead of FreeType output, so
+// their references do not depend on the font library's build
+const int STAND_IN_GLYPH_WIDTH = 8;
+const int STAND_IN_GLYPH_HEIGHT = 16;
+
+void measureText(TTF_Font *textFont, const char *message, int &width, int &height)
+{
+    if (standInText)
+    {
+        width = (int)strlen(message) * STAND_IN_GLYPH_WIDTH;
+        height = STAND_IN_GLYPH_HEIGHT;
+        return;
+    }
+    width = height = 0;
+    TTF_SizeText(textFont, message, &width, &height);
+}
+
+// Each stand-in glyph is a box whose height follows the character code, so a
+// changed message still changes the frame
+SDL_Surface *renderTextSurface(TTF_Font *textFont, const char *message, SDL_Color color)
+{
+    if (!standInText)
+    {
+        return TTF_RenderText_Solid(textFont, message, color);
+    }
+
+    int width, height;
+    measureText(textFont, message, width, height);
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, max(width, 1), height, 32, SDL_PIXELFORMAT_RGBA32);
+    if (surface == nullptr)
+    {
+        return nullptr;
+    }
+    Uint32 ink = color.r | color.g << 8 | color.b << 16 | 0xFF000000u;
+    for (int y = 0; y < surface->h; y++)
+    {
+        Uint32 *row = (Uint32 *)((Uint8 *)surface->pixels + (size_t)y * surface->pitch);
+        for (int x = 0; x < surface->w; x++)
+        {
+            unsigned char c = x < width ? (unsigned char)message[x / STAND_IN_GLYPH_WIDTH] : ' ';
+            int column = x % STAND_IN_GLYPH_WIDTH;
+            bool inked = c != ' ' && column >= 1 && column < STAND_IN_GLYPH_WIDTH - 1 && y >= 2 + c % 6 &&
+                         y < STAND_IN_GLYPH_HEIGHT - 2;
+            row[x] = inked ? ink : 0;
+        }
+    }
+    return surface;
+}
+
+void drawText(SDL_Renderer *renderer, TTF_Font *textFont, const char *message, int x, int y, SDL_Color color)
+{
+    AllocationScope scope(ALLOC_TEXT);
+    SDL_Surface *surface = renderTextSurface(textFont, message, color);
+
+    if (renderBackend == BACKEND_RASTER)
+    {
+        SDL_Surface *rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+        SDL_Rect dstrect = {x, y, rgba->w, rgba->h};
+        rasterBlit(frame, rgba, &dstrect);
+        SDL_FreeSurface(rgba);
+    }
+    else
+    {
+        SDL_Texture *texture = SDL_CreateTextureFromSurface(renderer, surface);
+
+        SDL_Rect dstrect = {x, y, surface->w, surface->h};
+        SDL_RenderCopy(renderer, texture, nullptr, &dstrect);
+
+        SDL_DestroyTexture(texture);
+    }
+
+    SDL_FreeSurface(surface);
+}
+
+TextCache scoreText;
+
+void drawCachedText(SDL_Renderer *renderer, TextCache &cache, TTF_Font *textFont, const char *message, int x, int y,
+                    SDL_Color color)
+{
+    bool stale = cache.font != textFont || strcmp(cache.message, message) != 0 || cache.color.r != color.r ||
+                 cache.color.g != color.g || cache.color.b != color.b || cache.color.a != color.a;
+    if (stale)
+    {
+        AllocationScope scope(ALLOC_TEXT);
+        freeImage(cache.image);
+        SDL_Surface *surface = renderTextSurface(textFont, message, color);
+        if (renderBackend == BACKEND_RASTER)
+        {
+            cache.image.surface = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+        }
+        else
+        {
+            cache.image.texture = SDL_CreateTextureFromSurface(renderer, surface);
+        }
+        cache.width = surface->w;
+        cache.height = surface->h;
+        SDL_FreeSurface(surface);
+
+        snprintf(cache.message, sizeof(cache.message), "%s", message);
+        cache.font = textFont;
+        cache.color = color;
+    }
+
+    SDL_Rect dstrect = {x, y, cache.width, cache.height};
+    drawImage(renderer, cache.image, &dstrect);
+}
+
+void renderText(SDL_Renderer *renderer, const char *message, int x, int y, SDL_Color color)
+{
+    drawText(renderer, font, message, x, y, color);
+}
+
+void scoreRenderText(SDL_Renderer *renderer, const char *message, int x, int y, SDL_Color color)
+{
+    drawText(renderer, score, message, x, y, color);
+}
+
+void finalScoreRenderText(SDL_Renderer *renderer, const char *message, int x, int y, SDL_Color color)
+{
+    drawText(renderer, finalScore, message, x, y, color);
+}
+
+void gameOverRenderText(SDL_Renderer *renderer, const char *message, int x, int y, SDL_Color color)
+{
+    drawText(renderer, game_over, message, x, y, color);
+}
+
+bool playBackgroundMusic(const char *musicPath)
+{
+    backgroundMusic = loadMusic(musicPath);
+    if (backgroundMusic == nullptr)
+    {
+        cout << "Failed to load background music! SDL_mixer Error: " << Mix_GetError() << endl;
+        return false;
+    }
+
+    if (Mix_PlayMusic(backgroundMusic, -1) == -1)
+    {
+        cout << "Failed to play background music! SDL_mixer Error: " << Mix_GetError() << endl;
+        return false;
+    }
+
+    return true;
+}
+
+void renderStartButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor)
+{
+    SDL_Rect startRect = {x, y, width, height};
+    setDrawColor(renderer, 0, 255, 0, 255);
+    fillRect(renderer, &startRect);
+    renderText(renderer, "Start Game", x + 30, y + 10, textColor);
+}
+
+void renderExitButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor)
+{
+    SDL_Rect exitRect = {x, y, width, height};
+    setDrawColor(renderer, 139, 0, 0, 255);
+    fillRect(renderer, &exitRect);
+    renderText(renderer, "Exit Game", x + 30, y + 10, textColor);
+}
+
+void renderGameOverButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor)
+{
+    SDL_Rect gameOverRect = {x, y, width, height};
+    setDrawColor(renderer, 128, 128, 128, 255);
+    fillRect(renderer, &gameOverRect);
+    gameOverRenderText(renderer, "Game Over", x + 30, y + 10, textColor);
+}
+
+void renderRestartButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor)
+{
+    SDL_Rect restartRect = {x, y, width, height};
+    setDrawColor(renderer, 0, 200, 0, 255);
+    fillRect(renderer, &restartRect);
+    renderText(renderer, "Restart Game", x + 30, y + 10, textColor);
+}
+
+bool handleRestartButtonClick(int mouseX, int mouseY, int x, int y, int width, int height)
+{
+    return (mouseX > x && mouseX < x + width && mouseY > y && mouseY < y + height);
+}
+
+bool handleGameOverButtonClick(int mouseX, int mouseY, int x, int y, int width, int height)
+{
+    return (mouseX > x && mouseX < x + width && mouseY > y && mouseY < y + height);
+}
+
+bool handleStartButtonClick(int mouseX, int mouseY, int x, int y, int width, int height)
+{
+    return (mouseX > x && mouseX < x + width && mouseY > y && mouseY < y + height);
+}
+
+bool handleExitButtonClick(int mouseX, int mouseY, int x, int y, int width, int height)
+{
+    return (mouseX > x && mouseX < x + width && mouseY > y && mouseY < y + height);
+}
+
+bool isMouseOverButton(int mouseX, int mouseY, int buttonX, int buttonY, int buttonWidth, int buttonHeight)
+{
+    return (mouseX >= buttonX && mouseX <= buttonX + buttonWidth &&
+            mouseY >= buttonY && mouseY <= buttonY + buttonHeight);
+}
+
+void drawCircle(SDL_Renderer *renderer, int centerX, int centerY, int radius)
+{
+    if (renderBackend == BACKEND_RASTER)
+    {
+        rasterFillCircle(frame, centerX + drawOrigin.x, centerY + drawOrigin.y, radius, frame.color);
+        return;
+    }
+
+    for (int w = 0; w < radius * 2; w++)
+    {
+        for (int h = 0; h < radius * 2; h++)
+        {
+            int dx = radius - w;
+            int dy = radius - h;
+            if ((dx * dx + dy * dy) <= (radius * radius))
+            {
+                drawPoint(renderer, centerX + dx, centerY + dy);
+            }
+        }
+    }
+}
+
+void renderBackground(SDL_Renderer *renderer, const Image &image)
+{
+    setDrawColor(renderer, 205, 20, 205, 255);
+    clearScreen(renderer);
+
+    drawImage(renderer, image, nullptr);
+}
+
+// Timers
+TimerId timerId(const TimerWheel &wheel, Sint32 index)
+{
+    return ((Uint32)(wheel.timers[index].generation & 0xFFF) << 20) | (Uint32)(index + 1);
+}
+
+void linkTimer(TimerWheel &wheel, Sint32 index)
+{
+    Timer &timer = wheel.timers[index];
+    Uint32 delta = timer.expires - wheel.now;
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1u << (TIMER_WHEEL_BITS * (level + 1))))
+    {
+        level++;
+    }
+
+    timer.slot = level * TIMER_WHEEL_SLOTS + ((timer.expires >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1));
+    timer.prev = -1;
+    timer.next = wheel.slots[timer.slot];
+    if (timer.next >= 0)
+    {
+        wheel.timers[timer.next].prev = index;
+    }
+    wheel.slots[timer.slot] = index;
+}
+
+void unlinkTimer(TimerWheel &wheel, Sint32 index)
+{
+    Timer &timer = wheel.timers[index];
+    if (timer.prev >= 0)
+    {
+        wheel.timers[timer.prev].next = timer.next;
+    }
+    else
+    {
+        wheel.slots[timer.slot] = timer.next;
+    }
+    if (timer.next >= 0)
+    {
+        wheel.timers[timer.next].prev = timer.prev;
+    }
+}
+
+void releaseTimer(TimerWheel &wheel, Sint32 index)
+{
+    Timer &timer = wheel.timers[index];
+    timer.slot = -1;
+    timer.generation++;
+    timer.next = wheel.freeList;
+    wheel.freeList = index;
+    wheel.active--;
+}
+
+// Cancels every timer and rewinds to tick 0, keeping the pool's capacity
+void clearTimers(TimerWheel &wheel)
+{
+    wheel.now = 0;
+    wheel.freeList = -1;
+    wheel.active = 0;
+    for (Sint32 i = (Sint32)wheel.timers.size() - 1; i >= 0; i--)
+    {
+        wheel.timers[i].slot = -1;
+        wheel.timers[i].generation++;
+        wheel.timers[i].next = wheel.freeList;
+        wheel.freeList = i;
+    }
+    fill(begin(wheel.slots), end(wheel.slots), -1);
+}
+
+// Fires delay ticks from now; delays are clamped to 1..TIMER_MAX_DELAY
+TimerId scheduleTimer(TimerWheel &wheel, Uint32 delay, TimerKind kind, Sint32 data)
+{
+    Sint32 index = wheel.freeList;
+    if (index >= 0)
+    {
+        wheel.freeList = wheel.timers[index].next;
+    }
+    else
+    {
+        index = (Sint32)wheel.timers.size();
+        wheel.timers.push_back({0, 0, 0, 0, -1, -1, -1});
+    }
+
+    Timer &timer = wheel.timers[index];
+    timer.expires = wheel.now + max(1u, min(delay, TIMER_MAX_DELAY));
+    timer.kind = (Uint16)kind;
+    timer.data = data;
+    linkTimer(wheel, index);
+    wheel.active++;
+    return timerId(wheel, index);
+}
+
+// Returns false for 0, or a timer that already fired or was cancelled
+bool cancelTimer(TimerWheel &wheel, TimerId id)
+{
+    Sint32 index = (Sint32)(id & 0xFFFFF) - 1;
+    if (index < 0 || index >= (Sint32)wheel.timers.size() || wheel.timers[index].slot < 0 ||
+        timerId(wheel, index) != id)
+    {
+        return false;
+    }
+
+    unlinkTimer(wheel, index);
+    releaseTimer(wheel, index);
+    return true;
+}
+
+bool hitsWall(const Level &level, SnakeSegment head)
+{
+    const LevelHeader &header = *level.header;
+    if (head.x < 0 || head.y < 0 || head.x >= header.width || head.y >= header.height)
+    {
+        return true;
+    }
+    return levelCellSet(level.wallBits, header.rowBytes, head.x / SNAKE_VELOCITY, head.y / SNAKE_VELOCITY);
+}
+
+bool hitsSelf(const SnakeBody &snake, SnakeSegment head)
+{
+    for (size_t i = 1; i < snake.size(); i++)
+    {
+        if (head.x == snake[i].x && head.y == snake[i].y)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// head must be on the board, which hitsWall has checked by now
+bool hitsObstacle(const GameState &game, SnakeSegment head)
+{
+    return !game.obstaclesDown && levelCellSet(game.level->obstacleBits, game.level->header->rowBytes, head.x / SNAKE_VELOCITY,
+                        head.y / SNAKE_VELOCITY);
+}
+
+bool reachesBonus(SDL_Point bonus, SnakeSegment head)
+{
+    int distX = head.x - bonus.x;
+    int distY = head.y - bonus.y;
+    int distance = sqrt(distX * distX + distY * distY);
+
+    return distance < BONUS_FOOD_RADIUS + SNAKE_VELOCITY / 2;
+}
+
+Uint32 nextRandom(GameState &game)
+{
+    Uint32 x = game.rngState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    game.rngState = x;
+    return x;
+}
+
+// compileLevel guarantees the field has an open cell, so the retries end
+SDL_Point randomOpenCell(GameState &game)
+{
+    const LevelHeader &header = *game.level->header;
+    SDL_Point cell;
+    do
+    {
+        cell.x = nextRandom(game) % (header.field.w / SNAKE_VELOCITY) * SNAKE_VELOCITY + header.field.x;
+        cell.y = nextRandom(game) % (header.field.h / SNAKE_VELOCITY) * SNAKE_VELOCITY + header.field.y;
+    } while (levelCellSet(game.level->wallBits, header.rowBytes, cell.x / SNAKE_VELOCITY, cell.y / SNAKE_VELOCITY));
+    return cell;
+}
+
+void spawnFood(GameState &game)
+{
+    SDL_Point cell = randomOpenCell(game);
+    game.food.x = cell.x;
+    game.food.y = cell.y;
+}
+
+void spawnBonusFood(GameState &game)
+{
+    const LevelHeader &header = *game.level->header;
+    for (int attempt = 0; attempt < 64; attempt++)
+    {
+        game.bonusFood.x = nextRandom(game) % (header.field.w - 2 * BONUS_FOOD_RADIUS) + header.field.x + BONUS_FOOD_RADIUS;
+        game.bonusFood.y = nextRandom(game) % (header.field.h - 2 * BONUS_FOOD_RADIUS) + header.field.y + BONUS_FOOD_RADIUS;
+        if (!levelCellSet(game.level->wallBits, header.rowBytes, game.bonusFood.x / SNAKE_VELOCITY,
+                          game.bonusFood.y / SNAKE_VELOCITY))
+        {
+            game.bonusFoodActive = true;
+            return;
+        }
+    }
+    game.bonusFoodActive = false;
+}
+
+// Without reserveBoard the snake grows its ring as it goes, for callers
+// keeping many games that would not fit a full board each
+void resetGame(GameState &game, const Level &level, Uint32 seed, Uint32 rules, bool reserveBoard)
+{
+    game.level = &level;
+    game.rngState = seed != 0 ? seed : 0x9E3779B9;
+
+    const LevelSpawn &spawn = level.spawns[seed % level.header->spawnCount];
+
+    // Room for a snake filling the board, so growing never reallocates, and
+    // clear() keeps the capacity, so restarting does not grow the heap
+    game.snake.reserve(reserveBoard ? (size_t)level.header->cols * level.header->rows + 1 : 1);
+    game.snake.clear();
+    game.snake.pushHead({spawn.x, spawn.y});
+    game.dirX = spawn.dirX;
+    game.dirY = spawn.dirY;
+
+    game.food = {0, 0, 10, 10};
+    spawnFood(game);
+
+    game.bonusFoodActive = false;
+    game.bonusFood = {0, 0};
+    game.score = 0;
+    game.foodCount = 0;
+
+    game.rules = rules;
+    clearTimers(game.timers);
+    game.timers.timers.reserve(8);
+    game.bonusTimer = 0;
+    game.bonusExpires = 0;
+    game.powerUpKind = POWER_NONE;
+    game.powerUp = {0, 0};
+    game.powerUpTimer = 0;
+    game.speed = POWER_NONE;
+    game.speedTimer = 0;
+    game.obstaclesDown = false;
+
+    if (rules & RULE_POWER_UPS)
+    {
+        scheduleTimer(game.timers, POWER_UP_INTERVAL, TIMER_POWER_UP_SPAWN);
+    }
+    if ((rules & RULE_OBSTACLE_CYCLE) && level.header->obstacleCount > 0)
+    {
+        scheduleTimer(game.timers, OBSTACLES_UP_TICKS, TIMER_OBSTACLES);
+    }
+}
+
+void spawnPowerUp(GameState &game)
+{
+    game.powerUpKind = (PowerUp)(POWER_SPEED_UP + nextRandom(game) % (POWER_KINDS - POWER_SPEED_UP));
+    game.powerUp = randomOpenCell(game);
+    game.powerUpTimer = scheduleTimer(game.timers, POWER_UP_TICKS, TIMER_POWER_UP_EXPIRE);
+}
+
+void takePowerUp(GameState &game, TickResult &result)
+{
+    result.powerUp = game.powerUpKind;
+    cancelTimer(game.timers, game.powerUpTimer);
+    game.powerUpTimer = 0;
+    game.powerUpKind = POWER_NONE;
+
+    if (result.powerUp == POWER_SHRINK)
+    {
+        game.snake.truncate(max((size_t)1, game.snake.size() / 2));
+        return;
+    }
+
+    // A second speed pickup replaces the first and restarts the clock
+    cancelTimer(game.timers, game.speedTimer);
+    game.speed = result.powerUp;
+    game.speedTimer = scheduleTimer(game.timers, SPEED_TICKS, TIMER_SPEED_END);
+}
+
+void fireGameTimer(GameState &game, const Timer &timer, TickResult &result)
+{
+    switch ((TimerKind)timer.kind)
+    {
+    case TIMER_BONUS_EXPIRE:
+        game.bonusFoodActive = false;
+        game.bonusTimer = 0;
+        game.bonusExpires = 0;
+        result.bonusExpired = true;
+        break;
+    case TIMER_POWER_UP_SPAWN:
+        if (game.powerUpKind == POWER_NONE)
+        {
+            spawnPowerUp(game);
+        }
+        scheduleTimer(game.timers, POWER_UP_INTERVAL, TIMER_POWER_UP_SPAWN);
+        break;
+    case TIMER_POWER_UP_EXPIRE:
+        game.powerUpKind = POWER_NONE;
+        game.powerUpTimer = 0;
+        break;
+    case TIMER_SPEED_END:
+        game.speed = POWER_NONE;
+        game.speedTimer = 0;
+        break;
+    case TIMER_OBSTACLES:
+        game.obstaclesDown = !game.obstaclesDown;
+        result.obstaclesChanged = true;
+        scheduleTimer(game.timers, game.obstaclesDown ? OBSTACLES_DOWN_TICKS : OBSTACLES_UP_TICKS, TIMER_OBSTACLES);
+        break;
+    }
+}
+
+// Real time between ticks; the speed power-ups change the pace, not the
+// simulation, so timers and replays count the same ticks either way
+Uint32 tickDelayMs(const GameState &game)
+{
+    return game.speed == POWER_SPEED_UP ? FAST_TICK_MS : game.speed == POWER_SLOW_DOWN ? SLOW_TICK_MS : TICK_MS;
+}
+
+void steerSnake(GameState &game, SDL_Keycode key)
+{
+    switch (key)
+    {
+    case SDLK_UP:
+    case SDLK_w:
+        if (game.dirY == 0)
+        {
+            game.dirX = 0;
+            game.dirY = -1;
+        }
+        break;
+    case SDLK_DOWN:
+    case SDLK_s:
+        if (game.dirY == 0)
+        {
+            game.dirX = 0;
+            game.dirY = 1;
+        }
+        break;
+    case SDLK_LEFT:
+    case SDLK_a:
+        if (game.dirX == 0)
+        {
+            game.dirX = -1;
+            game.dirY = 0;
+        }
+        break;
+    case SDLK_RIGHT:
+    case SDLK_d:
+        if (game.dirX == 0)
+        {
+            game.dirX = 1;
+            game.dirY = 0;
+        }
+        break;
+    }
+}
+
+TickResult tickGame(GameState &game)
+{
+    TickResult result = {COLLISION_NONE, false, false, false, POWER_NONE, false, false};
+    SnakeBody &snake = game.snake;
+
+    SnakeSegment newHead = {snake[0].x + game.dirX * SNAKE_VELOCITY, snake[0].y + game.dirY * SNAKE_VELOCITY};
+
+    if (hitsWall(*game.level, newHead))
+    {
+        result.collision = COLLISION_WALL;
+        return result;
+    }
+
+    if (hitsSelf(snake, newHead))
+    {
+        result.collision = COLLISION_SELF;
+        return result;
+    }
+
+    snake.pushHead(newHead);
+
+    if (newHead.x == game.food.x && newHead.y == game.food.y)
+    {
+        result.ateFood = true;
+        spawnFood(game);
+        game.score += 5;
+
+        game.foodCount++;
+        if (game.foodCount % 5 == 0)
+        {
+            spawnBonusFood(game);
+            result.spawnedBonus = game.bonusFoodActive;
+
+            if (game.rules & RULE_BONUS_EXPIRY)
+            {
+                cancelTimer(game.timers, game.bonusTimer);
+                game.bonusTimer = 0;
+                game.bonusExpires = 0;
+                if (game.bonusFoodActive)
+                {
+                    game.bonusTimer = scheduleTimer(game.timers, BONUS_FOOD_TICKS, TIMER_BONUS_EXPIRE);
+                    game.bonusExpires = game.timers.now + BONUS_FOOD_TICKS;
+                }
+            }
+        }
+    }
+    else
+    {
+        snake.popTail();
+    }
+
+    if (game.bonusFoodActive && reachesBonus(game.bonusFood, newHead))
+    {
+        result.ateBonus = true;
+        game.score += 10;
+        game.bonusFoodActive = false;
+        cancelTimer(game.timers, game.bonusTimer);
+        game.bonusTimer = 0;
+        game.bonusExpires = 0;
+    }
+
+    if (game.powerUpKind != POWER_NONE && newHead.x == game.powerUp.x && newHead.y == game.powerUp.y)
+    {
+        takePowerUp(game, result);
+    }
+
+    if (hitsObstacle(game, newHead))
+    {
+        result.collision = COLLISION_OBSTACLE;
+    }
+
+    advanceTimers(game.timers, [&](const Timer &timer) { fireGameTimer(game, timer, result); });
+    return result;
+}
+
+// Steers toward the food, taking the first move that does not crash, for
+// unattended play. Returns 0 (no key) when boxed in.
+SDL_Keycode autopilotKey(const GameState &game)
+{
+    const SDL_Keycode keys[4] = {SDLK_UP, SDLK_DOWN, SDLK_LEFT, SDLK_RIGHT};
+    const int stepX[4] = {0, 0, -1, 1};
+    const int stepY[4] = {-1, 1, 0, 0};
+    SnakeSegment head = game.snake[0];
+
+    SDL_Keycode best = 0;
+    int bestDistance = INT_MAX;
+    for (int i = 0; i < 4; i++)
+    {
+        if (stepX[i] == -game.dirX && stepY[i] == -game.dirY)
+        {
+            continue;
+        }
+        SnakeSegment next = {head.x + stepX[i] * SNAKE_VELOCITY, head.y + stepY[i] * SNAKE_VELOCITY};
+        if (hitsWall(*game.level, next) || hitsSelf(game.snake, next) || hitsObstacle(game, next))
+        {
+            continue;
+        }
+        int distance = abs(next.x - game.food.x) + abs(next.y - game.food.y);
+        if (distance < bestDistance)
+        {
+            best = keys[i];
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
+const SDL_Keycode envActionKeys[] = {0, SDLK_UP, SDLK_DOWN, SDLK_LEFT, SDLK_RIGHT};
+
+inline Uint8 *envPlane(EnvBatch &batch, int index, EnvPlane plane)
+{
+    return batch.observations + ((size_t)index * ENV_PLANES + plane) * batch.planeSize;
+}
+
+inline void setEnvCell(EnvBatch &batch, Uint8 *plane, int x, int y, Uint8 value)
+{
+    plane[(size_t)(y / SNAKE_VELOCITY) * batch.cols + x / SNAKE_VELOCITY] = value;
+}
+
+// Marks every cell whose top-left corner reachesBonus accepts
+void setEnvBonus(EnvBatch &batch, Uint8 *plane, SDL_Point bonus, Uint8 value)
+{
+    const int reach = BONUS_FOOD_RADIUS + SNAKE_VELOCITY / 2;
+    int firstCol = max(0, (bonus.x - reach) / SNAKE_VELOCITY), lastCol = min(batch.cols - 1, (bonus.x + reach) / SNAKE_VELOCITY);
+    int firstRow = max(0, (bonus.y - reach) / SNAKE_VELOCITY), lastRow = min(batch.rows - 1, (bonus.y + reach) / SNAKE_VELOCITY);
+    for (int row = firstRow; row <= lastRow; row++)
+    {
+        for (int col = firstCol; col <= lastCol; col++)
+        {
+            if (reachesBonus(bonus, {col * SNAKE_VELOCITY, row * SNAKE_VELOCITY}))
+            {
+                plane[(size_t)row * batch.cols + col] = value;
+            }
+        }
+    }
+}
+
+void writeEnvBody(EnvBatch &batch, int index)
+{
+    Uint8 *body = envPlane(batch, index, ENV_PLANE_BODY);
+    memset(body, 0, batch.planeSize);
+    const SnakeBody &snake = batch.games[index].snake;
+    for (size_t i = 0; i < snake.size(); i++)
+    {
+        setEnvCell(batch, body, snake[i].x, snake[i].y, 1);
+    }
+}
+
+void writeEnvObstacles(EnvBatch &batch, int index)
+{
+    const vector<Uint8> &plane = batch.games[index].obstaclesDown ? batch.wallPlane : batch.obstaclePlane;
+    memcpy(envPlane(batch, index, ENV_PLANE_OBSTACLES), plane.data(), batch.planeSize);
+}
+
+void resetEnv(EnvBatch &batch, int index)
+{
+    Uint32 &seed = batch.seeds[index];
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    GameState &game = batch.games[index];
+    resetGame(game, *batch.level, seed, batch.rules);
+
+    memset(envPlane(batch, index, ENV_PLANE_BODY), 0, ENV_PLANE_OBSTACLES * batch.planeSize);
+    writeEnvObstacles(batch, index);
+    writeEnvBody(batch, index);
+    setEnvCell(batch, envPlane(batch, index, ENV_PLANE_HEAD), game.snake[0].x, game.snake[0].y, 1);
+    setEnvCell(batch, envPlane(batch, index, ENV_PLANE_FOOD), game.food.x, game.food.y, 1);
+}
+
+void stepEnv(EnvBatch &batch, int index)
+{
+    GameState &game = batch.games[index];
+    Uint8 action = batch.actions[index];
+    if (action < sizeof(envActionKeys) / sizeof(envActionKeys[0]))
+    {
+        steerSnake(game, envActionKeys[action]);
+    }
+
+    SnakeSegment oldHead = game.snake.front(), oldTail = game.snake.back();
+    SDL_Rect oldFood = game.food;
+    bool oldBonusActive = game.bonusFoodActive;
+    SDL_Point oldBonus = game.bonusFood;
+    PowerUp oldPowerUpKind = game.powerUpKind;
+    SDL_Point oldPowerUp = game.powerUp;
+    int oldScore = game.score;
+
+    TickResult result = tickGame(game);
+    batch.rewards[index] = (float)(game.score - oldScore);
+    if (result.collision != COLLISION_NONE)
+    {
+        batch.dones[index] = 1;
+        resetEnv(batch, index);
+        return;
+    }
+    batch.dones[index] = 0;
+
+    SnakeSegment head = game.snake.front();
+    Uint8 *body = envPlane(batch, index, ENV_PLANE_BODY);
+    if (result.powerUp == POWER_SHRINK)
+    {
+        writeEnvBody(batch, index);
+    }
+    else
+    {
+        if (!result.ateFood)
+        {
+            setEnvCell(batch, body, oldTail.x, oldTail.y, 0);
+        }
+        setEnvCell(batch, body, head.x, head.y, 1);
+    }
+
+    Uint8 *headPlane = envPlane(batch, index, ENV_PLANE_HEAD);
+    setEnvCell(batch, headPlane, oldHead.x, oldHead.y, 0);
+    setEnvCell(batch, headPlane, head.x, head.y, 1);
+
+    if (result.ateFood)
+    {
+        Uint8 *food = envPlane(batch, index, ENV_PLANE_FOOD);
+        setEnvCell(batch, food, oldFood.x, oldFood.y, 0);
+        setEnvCell(batch, food, game.food.x, game.food.y, 1);
+    }
+
+    if (oldBonusActive != game.bonusFoodActive || oldBonus.x != game.bonusFood.x || oldBonus.y != game.bonusFood.y)
+    {
+        Uint8 *bonus = envPlane(batch, index, ENV_PLANE_BONUS);
+        if (oldBonusActive)
+        {
+            setEnvBonus(batch, bonus, oldBonus, 0);
+        }
+        if (game.bonusFoodActive)
+        {
+            setEnvBonus(batch, bonus, game.bonusFood, 1);
+        }
+    }
+
+    if (oldPowerUpKind != game.powerUpKind || oldPowerUp.x != game.powerUp.x || oldPowerUp.y != game.powerUp.y)
+    {
+        Uint8 *powerUp = envPlane(batch, index, ENV_PLANE_POWER_UP);
+        if (oldPowerUpKind != POWER_NONE)
+        {
+            setEnvCell(batch, powerUp, oldPowerUp.x, oldPowerUp.y, 0);
+        }
+        if (game.powerUpKind != POWER_NONE)
+        {
+            setEnvCell(batch, powerUp, game.powerUp.x, game.powerUp.y, (Uint8)game.powerUpKind);
+        }
+    }
+
+    if (result.obstaclesChanged)
+    {
+        writeEnvObstacles(batch, index);
+    }
+}
+
+void stepEnvShard(EnvBatch &batch, int shard)
+{
+    int end = min(batch.count, (shard + 1) * batch.shardSize);
+    for (int i = shard * batch.shardSize; i < end; i++)
+    {
+        stepEnv(batch, i);
+    }
+}
+
+// Workers spin briefly between steps, then back off to short sleeps so an
+// idle batch does not hold a core
+void envWorkerLoop(EnvBatch *batch, int shard)
+{
+    Uint32 seen = 0;
+    while (true)
+    {
+        int idle = 0;
+        Uint32 generation;
+        while ((generation = batch->generation.load(std::memory_order_acquire)) == seen)
+        {
+            if (batch->stopping.load(std::memory_order_acquire))
+            {
+                return;
+            }
+            if (++idle < 4096)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+        seen = generation;
+        stepEnvShard(*batch, shard);
+        batch->finished.fetch_add(1, std::memory_order_release);
+    }
+}
+
+// observations holds count * envObservationSize(batch) bytes, rewards and
+// dones count entries each; all three stay owned by the caller and are
+// written in place by every reset and step. rules is a set of Rule flags.
+// threads <= 1 steps on the calling thread only.
+bool createEnvBatch(EnvBatch &batch, const Level &level, int count, Uint32 seed, Uint32 rules, int threads,
+                    Uint8 *observations, float *rewards, Uint8 *dones)
+{
+    if (count <= 0 || observations == nullptr || rewards == nullptr || dones == nullptr)
+    {
+        cout << "Invalid environment batch" << endl;
+        return false;
+    }
+
+    const LevelHeader &header = *level.header;
+    batch.level = &level;
+    batch.rules = rules;
+    batch.count = count;
+    batch.cols = header.cols;
+    batch.rows = header.rows;
+    batch.planeSize = (size_t)header.cols * header.rows;
+    batch.observations = observations;
+    batch.rewards = rewards;
+    batch.dones = dones;
+
+    batch.obstaclePlane.assign(batch.planeSize, 0);
+    batch.wallPlane.assign(batch.planeSize, 0);
+    for (int row = 0; row < header.rows; row++)
+    {
+        for (int col = 0; col < header.cols; col++)
+        {
+            size_t cell = (size_t)row * header.cols + col;
+            batch.wallPlane[cell] = levelCellSet(level.wallBits, header.rowBytes, col, row);
+            batch.obstaclePlane[cell] = batch.wallPlane[cell] || levelCellSet(level.obstacleBits, header.rowBytes, col, row);
+        }
+    }
+
+    // A full-board snake fits without the ring ever growing during a step
+    batch.games.assign(count, GameState());
+    batch.seeds.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        batch.games[i].snake.reserve(batch.planeSize + 1);
+        batch.seeds[i] = (seed + 1) * 0x9E3779B9 ^ (Uint32)(i + 1) * 0x85EBCA6B;
+        if (batch.seeds[i] == 0)
+        {
+            batch.seeds[i] = 1;
+        }
+        resetEnv(batch, i);
+        rewards[i] = 0;
+        dones[i] = 0;
+    }
+
+    int shards = max(1, min(threads, count));
+    batch.shardSize = (count + shards - 1) / shards;
+    shards = (count + batch.shardSize - 1) / batch.shardSize;
+    batch.stopping = false;
+    batch.generation = 0;
+    for (int shard = 1; shard < shards; shard++)
+    {
+        batch.workers.emplace_back(envWorkerLoop, &batch, shard);
+    }
+    return true;
+}
+
+size_t envObservationSize(const EnvBatch &batch)
+{
+    return ENV_PLANES * batch.planeSize;
+}
+
+// actions holds one EnvAction per game
+void stepEnvBatch(EnvBatch &batch, const Uint8 *actions)
+{
+    batch.actions = actions;
+    batch.finished.store(0, std::memory_order_relaxed);
+    batch.generation.fetch_add(1, std::memory_order_release);
+
+    stepEnvShard(batch, 0);
+    while (batch.finished.load(std::memory_order_acquire) != (int)batch.workers.size())
+    {
+        std::this_thread::yield();
+    }
+}
+
+void destroyEnvBatch(EnvBatch &batch)
+{
+    batch.stopping.store(true, std::memory_order_release);
+    for (std::thread &worker : batch.workers)
+    {
+        worker.join();
+    }
+    batch.workers.clear();
+    batch.games.clear();
+}
+
+// Effects. Particles live in a fixed pool stored as structure-of-arrays, so
+// updating is a few straight loops the compiler vectorises, dead particles
+// are swap-removed and the whole pool is drawn in one batch: one
+// SDL_RenderGeometry call, or one pass of span blends on the raster backend.
+// Nothing here allocates; emitting into a full pool drops the surplus.
+const int PARTICLE_SIZE = 3;
+const float PARTICLE_GRAVITY = 90.0f;
+
+// Raster quads, filled from the pool in a straight loop before blending
+struct ParticleQuads
+{
+    alignas(32) int left[PARTICLE_CAPACITY];
+    alignas(32) int top[PARTICLE_CAPACITY];
+    alignas(32) Uint32 alpha[PARTICLE_CAPACITY];
+};
+
+ParticlePool particles;
+ParticleQuads particleQuads;
+SDL_Vertex particleVertices[PARTICLE_CAPACITY * 4];
+int particleIndices[PARTICLE_CAPACITY * 6];
+
+// Two triangles per quad, fixed for the life of the renderer
+void buildParticleIndices()
+{
+    const int quad[6] = {0, 1, 2, 2, 1, 3};
+    for (int i = 0; i < PARTICLE_CAPACITY; i++)
+    {
+        for (int k = 0; k < 6; k++)
+        {
+            particleIndices[i * 6 + k] = i * 4 + quad[k];
+        }
+    }
+}
+
+float particleRandom(ParticlePool &pool)
+{
+    Uint32 x = pool.rngState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pool.rngState = x;
+    return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+void emitParticles(ParticlePool &pool, float x, float y, int count, float minSpeed, float maxSpeed, float life,
+                   const Uint32 *palette, int paletteSize)
+{
+    count = min(count, PARTICLE_CAPACITY - pool.count);
+    for (int k = 0; k < count; k++)
+    {
+        int i = pool.count++;
+        float angle = particleRandom(pool) * 6.2831853f;
+        float speed = minSpeed + (maxSpeed - minSpeed) * particleRandom(pool);
+        pool.x[i] = x;
+        pool.y[i] = y;
+        pool.vx[i] = cosf(angle) * speed;
+        pool.vy[i] = sinf(angle) * speed;
+        pool.life[i] = life * (0.5f + 0.5f * particleRandom(pool));
+        pool.fade[i] = 1.0f / pool.life[i];
+        pool.color[i] = palette[(int)(particleRandom(pool) * paletteSize)];
+    }
+}
+
+// Bursts for eating, the bonus and pickups, at the head and bonus positions
+// the tick left
+void emitPickupEffects(ParticlePool &pool, SnakeSegment head, SDL_Point bonusFood, const TickResult &result)
+{
+    const float half = SNAKE_VELOCITY / 2.0f;
+    if (result.ateFood)
+    {
+        emitParticles(pool, head.x + half, head.y + half, 48, 40, 140, 0.5f, eatPalette,
+                      sizeof(eatPalette) / sizeof(eatPalette[0]));
+    }
+
+    if (result.ateBonus)
+    {
+        emitParticles(pool, bonusFood.x, bonusFood.y, 96, 20, 220, 0.9f, bonusPalette,
+                      sizeof(bonusPalette) / sizeof(bonusPalette[0]));
+    }
+
+    if (result.powerUp != POWER_NONE)
+    {
+        emitParticles(pool, head.x + half, head.y + half, 64, 30, 160, 0.7f, bonusPalette,
+                      sizeof(bonusPalette) / sizeof(bonusPalette[0]));
+    }
+}
+
+// Bursts for what happened on a tick: eating, the bonus, or a death, which
+// blows up every segment of the body.
+void emitTickEffects(ParticlePool &pool, const GameState &game, const TickResult &result)
+{
+    emitPickupEffects(pool, game.snake[0], game.bonusFood, result);
+
+    if (result.collision == COLLISION_WALL || result.collision == COLLISION_SELF)
+    {
+        const float half = SNAKE_VELOCITY / 2.0f;
+        int perSegment = max(2, min(32, PARTICLE_CAPACITY / (int)game.snake.size()));
+        for (size_t i = 0; i < game.snake.size(); i++)
+        {
+            emitParticles(pool, game.snake[i].x + half, game.snake[i].y + half, perSegment, 30, 180, 1.4f, deathPalette,
+                          sizeof(deathPalette) / sizeof(deathPalette[0]));
+        }
+    }
+}
+
+void updateParticles(ParticlePool &pool, float dt)
+{
+    // Whole vectors only: slots past count are spare and safe to update
+    const int n = (pool.count + 7) & ~7;
+    for (int i = 0; i < n; i++)
+    {
+        pool.x[i] += pool.vx[i] * dt;
+        pool.y[i] += pool.vy[i] * dt;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        pool.vy[i] += PARTICLE_GRAVITY * dt;
+        pool.life[i] -= dt;
+    }
+
+    for (int i = 0; i < pool.count;)
+    {
+        if (pool.life[i] > 0)
+        {
+            i++;
+            continue;
+        }
+        int last = --pool.count;
+        pool.x[i] = pool.x[last];
+        pool.y[i] = pool.y[last];
+        pool.vx[i] = pool.vx[last];
+        pool.vy[i] = pool.vy[last];
+        pool.life[i] = pool.life[last];
+        pool.fade[i] = pool.fade[last];
+        pool.color[i] = pool.color[last];
+    }
+}
+
+// Advances by the wall-clock time since the last call, capped so a pause
+// does not fast-forward the effects.
+void advanceParticles(ParticlePool &pool)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    float dt = pool.lastUpdate == 0 ? 0 : (now - pool.lastUpdate) / (float)SDL_GetPerformanceFrequency();
+    pool.lastUpdate = now;
+    updateParticles(pool, min(dt, 0.25f));
+}
+
+void clearParticles(ParticlePool &pool)
+{
+    pool.count = 0;
+    pool.lastUpdate = 0;
+}
+
+// Pixels a particle may touch on either backend; SDL_RenderGeometry places
+// its quad at fractional positions, so allow a pixel around it
+SDL_Rect particleBounds(const ParticlePool &pool, int i)
+{
+    const float half = PARTICLE_SIZE / 2.0f;
+    return {(int)floorf(pool.x[i] - half) - 1, (int)floorf(pool.y[i] - half) - 1, PARTICLE_SIZE + 2, PARTICLE_SIZE + 2};
+}
+
+// Blends every particle's quad into fb, clipped with integer compares. Each
+// quad's colour terms are computed once for its pixels, with blendPixel's
+// rounding, so the result matches blending quad by quad.
+void rasterBlendParticles(Framebuffer &fb, const ParticlePool &pool, SDL_Point origin)
+{
+    const float half = PARTICLE_SIZE / 2.0f;
+    for (int i = 0; i < pool.count; i++)
+    {
+        particleQuads.left[i] = (int)(pool.x[i] - half) + origin.x;
+        particleQuads.top[i] = (int)(pool.y[i] - half) + origin.y;
+        particleQuads.alpha[i] = (Uint32)(255 * min(1.0f, pool.life[i] * pool.fade[i]));
+    }
+
+    const int clipRight = fb.clip.x + fb.clip.w, clipBottom = fb.clip.y + fb.clip.h;
+    for (int i = 0; i < pool.count; i++)
+    {
+        int x0 = max(particleQuads.left[i], fb.clip.x), x1 = min(particleQuads.left[i] + PARTICLE_SIZE, clipRight);
+        int y0 = max(particleQuads.top[i], fb.clip.y), y1 = min(particleQuads.top[i] + PARTICLE_SIZE, clipBottom);
+        if (x0 >= x1 || y0 >= y1)
+        {
+            continue;
+        }
+
+        Uint32 a = particleQuads.alpha[i], keep = 255 - a, c = pool.color[i];
+        Uint32 r = (c & 0xFF) * a + 128, g = (c >> 8 & 0xFF) * a + 128, b = (c >> 16 & 0xFF) * a + 128;
+        for (int y = y0; y < y1; y++)
+        {
+            Uint32 *dst = &fb.pixels[(size_t)y * fb.width];
+            for (int x = x0; x < x1; x++)
+            {
+                Uint32 d = dst[x];
+                Uint32 xr = r + (d & 0xFF) * keep, xg = g + (d >> 8 & 0xFF) * keep, xb = b + (d >> 16 & 0xFF) * keep;
+                dst[x] = 0xFF000000 | (xb + (xb >> 8)) >> 8 << 16 | (xg + (xg >> 8)) >> 8 << 8 | (xr + (xr >> 8)) >> 8;
+            }
+        }
+    }
+}
+
+void renderParticles(SDL_Renderer *renderer, const ParticlePool &pool)
+{
+    const float half = PARTICLE_SIZE / 2.0f;
+    if (renderBackend == BACKEND_RASTER)
+    {
+        rasterBlendParticles(frame, pool, drawOrigin);
+        return;
+    }
+
+    if (pool.count == 0)
+    {
+        return;
+    }
+
+    for (int i = 0; i < pool.count; i++)
+    {
+        Uint32 c = pool.color[i];
+        SDL_Color color = {(Uint8)c, (Uint8)(c >> 8), (Uint8)(c >> 16),
+                           (Uint8)(255 * min(1.0f, pool.life[i] * pool.fade[i]))};
+        float left = pool.x[i] - half + drawOrigin.x, top = pool.y[i] - half + drawOrigin.y;
+        SDL_Vertex *v = &particleVertices[i * 4];
+        v[0] = {{left, top}, color, {0, 0}};
+        v[1] = {{left + PARTICLE_SIZE, top}, color, {0, 0}};
+        v[2] = {{left, top + PARTICLE_SIZE}, color, {0, 0}};
+        v[3] = {{left + PARTICLE_SIZE, top + PARTICLE_SIZE}, color, {0, 0}};
+    }
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderGeometry(renderer, nullptr, particleVertices, pool.count * 4, particleIndices, pool.count * 6);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+}
+
+int segmentIntensity(size_t i)
+{
+    return 200 - (int)(pow(i, 1.5) * 5);
+}
+
+// The colours segment i is drawn with, as setDrawColor truncates them
+Uint32 segmentStyle(size_t i)
+{
+    int colorIntensity = segmentIntensity(i);
+    return i == 0 ? 0x10000 : ((Uint32)(Uint8)(colorIntensity + 30) << 8) | (Uint8)colorIntensity;
+}
+
+// Pixels covered by a segment's outermost (glow) circle
+SDL_Rect segmentBounds(const SnakeSegment &segment)
+{
+    const int radius = SNAKE_VELOCITY / 2 + 2;
+    return {segment.x + SNAKE_VELOCITY / 2 - radius + 1, segment.y + SNAKE_VELOCITY / 2 - radius + 1, radius * 2, radius * 2};
+}
+
+// Draws the segments that touch region, or all of them when it is null
+void renderSnake(SDL_Renderer *renderer, const SnakeBody &snake, const SDL_Rect *region)
+{
+    for (size_t i = 0; i < snake.size(); i++)
+    {
+        SDL_Rect bounds = segmentBounds(snake[i]);
+        if (region != nullptr && !SDL_HasIntersection(region, &bounds))
+        {
+            continue;
+        }
+
+        int colorIntensity = segmentIntensity(i);
+        int glowIntensity = colorIntensity + 30;
+
+        setDrawColor(renderer, 0, glowIntensity, 0, 100);
+        drawCircle(renderer, snake[i].x + SNAKE_VELOCITY / 2, snake[i].y + SNAKE_VELOCITY / 2, SNAKE_VELOCITY / 2 + 2);
+
+        setDrawColor(renderer, 128, 128, 128, 255);
+        drawCircle(renderer, snake[i].x + SNAKE_VELOCITY / 2, snake[i].y + SNAKE_VELOCITY / 2, SNAKE_VELOCITY / 2 + 1);
+
+        if (i == 0)
+        {
+            setDrawColor(renderer, 0, 255, 0, 255);
+            drawCircle(renderer, snake[i].x + SNAKE_VELOCITY / 2, snake[i].y + SNAKE_VELOCITY / 2, SNAKE_VELOCITY / 2);
+
+            setDrawColor(renderer, 0, 0, 0, 255);
+            drawPoint(renderer, snake[i].x + SNAKE_VELOCITY / 4, snake[i].y + SNAKE_VELOCITY / 4);
+            drawPoint(renderer, snake[i].x + (3 * SNAKE_VELOCITY) / 4, snake[i].y + SNAKE_VELOCITY / 4);
+        }
+        else
+        {
+            setDrawColor(renderer, 0, colorIntensity, 0, 255);
+            drawCircle(renderer, snake[i].x + SNAKE_VELOCITY / 2, snake[i].y + SNAKE_VELOCITY / 2, SNAKE_VELOCITY / 2);
+        }
+    }
+}
+
+const SDL_Color powerUpColors[POWER_KINDS] = {{0, 0, 0, 0}, {255, 140, 0, 255}, {0, 200, 255, 255}, {200, 0, 200, 255}};
+
+SDL_Rect foodBounds(const GameState &game)
+{
+    return {game.food.x, game.food.y, 15, 15};
+}
+
+SDL_Rect bonusFoodBounds(const GameState &game)
+{
+    return {game.bonusFood.x - BONUS_FOOD_RADIUS, game.bonusFood.y - BONUS_FOOD_RADIUS, 25, 25};
+}
+
+// The bar under the bonus, full width when it appears and empty as it expires
+SDL_Rect bonusCountdownBounds(const GameState &game)
+{
+    return {game.bonusFood.x - BONUS_FOOD_RADIUS, game.bonusFood.y + BONUS_FOOD_RADIUS + 7, 25, 3};
+}
+
+SDL_Rect powerUpBounds(const GameState &game)
+{
+    return segmentBounds({game.powerUp.x, game.powerUp.y});
+}
+
+SDL_Rect scoreBounds(int value)
+{
+    char message[32];
+    snprintf(message, sizeof(message), "Score: %d", value);
+    int width, height;
+    measureText(score, message, width, height);
+    return {1, 1, width, height};
+}
+
+bool touches(const SDL_Rect *region, const SDL_Rect &bounds)
+{
+    return region == nullptr || SDL_HasIntersection(region, &bounds);
+}
+
+// Where the board's origin is drawn on screen. Boards that fit the window
+// are centred; larger ones scroll in quarter-screen steps that keep the head
+// near the middle, so the view moves rarely and dirty rects stay useful.
+SDL_Point boardOrigin(const GameState &game)
+{
+    auto axis = [](int board, int screen, int head) {
+        if (board <= screen)
+        {
+            return (screen - board) / 2;
+        }
+        int step = screen / 4;
+        int scroll = max(0, head - screen / 2 + step / 2) / step * step;
+        return -min(scroll, board - screen);
+    };
+    const LevelHeader &header = *game.level->header;
+    return {axis(header.width, SCREEN_WIDTH, game.snake[0].x), axis(header.height, SCREEN_HEIGHT, game.snake[0].y)};
+}
+
+// Draws the playfield. With a region (in screen coordinates), only what
+// touches it is drawn; the caller clips to the region so partially covered
+// shapes stay exact. Board space is drawn through drawOrigin, and anything
+// off screen is skipped.
+void renderGameRegion(SDL_Renderer *renderer, const GameState &game, const SDL_Rect *region)
+{
+    const LevelHeader &header = *game.level->header;
+    SDL_Point origin = boardOrigin(game);
+    SDL_Rect screen = region ? *region : SDL_Rect{0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
+    SDL_Rect board = {origin.x, origin.y, header.width, header.height};
+    bool coversScreen = origin.x <= 0 && origin.y <= 0 && origin.x + header.width >= SCREEN_WIDTH &&
+                        origin.y + header.height >= SCREEN_HEIGHT;
+
+    // Around a board smaller than the window, the margin is wall-coloured
+    if (coversScreen)
+    {
+        setDrawColor(renderer, 100, 150, 200, 255);
+    }
+    else
+    {
+        setDrawColor(renderer, 180, 180, 180, 255);
+    }
+    if (region == nullptr)
+    {
+        clearScreen(renderer);
+    }
+    else
+    {
+        fillRect(renderer, region);
+    }
+    if (!coversScreen && SDL_IntersectRect(&screen, &board, &board))
+    {
+        setDrawColor(renderer, 100, 150, 200, 255);
+        fillRect(renderer, &board);
+    }
+
+    drawOrigin = origin;
+    SDL_Rect visible = {screen.x - origin.x, screen.y - origin.y, screen.w, screen.h};
+
+    const Level &level = *game.level;
+    setDrawColor(renderer, 180, 180, 180, 0);
+    for (Uint32 i = 0; i < level.header->wallCount; i++)
+    {
+        if (touches(&visible, level.walls[i]))
+        {
+            fillRect(renderer, &level.walls[i]);
+        }
+    }
+
+    // Lowered obstacles stay faintly visible so players see where they return
+    if (game.obstaclesDown)
+    {
+        setDrawColor(renderer, 85, 130, 175, 255);
+    }
+    else
+    {
+        setDrawColor(renderer, 0, 0, 0, 0);
+    }
+    for (Uint32 i = 0; i < level.header->obstacleCount; i++)
+    {
+        if (touches(&visible, level.obstacles[i]))
+        {
+            fillRect(renderer, &level.obstacles[i]);
+        }
+    }
+
+    renderSnake(renderer, game.snake, &visible);
+
+    SDL_Rect foodRect = foodBounds(game);
+    if (touches(&visible, foodRect))
+    {
+        drawImage(renderer, regularFoodImage, &foodRect);
+    }
+
+    SDL_Rect bonusFoodRect = bonusFoodBounds(game);
+    if (game.bonusFoodActive && touches(&visible, bonusFoodRect))
+    {
+        drawImage(renderer, bonusFoodImage, &bonusFoodRect);
+    }
+
+    SDL_Rect countdownRect = bonusCountdownBounds(game);
+    if (game.bonusFoodActive && game.bonusExpires != 0 && touches(&visible, countdownRect))
+    {
+        countdownRect.w = countdownRect.w * (game.bonusExpires - game.timers.now) / BONUS_FOOD_TICKS;
+        setDrawColor(renderer, 255, 215, 0, 255);
+        fillRect(renderer, &countdownRect);
+    }
+
+    if (game.powerUpKind != POWER_NONE && touches(&visible, powerUpBounds(game)))
+    {
+        const SDL_Color &color = powerUpColors[game.powerUpKind];
+        setDrawColor(renderer, color.r, color.g, color.b, 255);
+        drawCircle(renderer, game.powerUp.x + SNAKE_VELOCITY / 2, game.powerUp.y + SNAKE_VELOCITY / 2, SNAKE_VELOCITY / 2);
+        setDrawColor(renderer, 255, 255, 255, 255);
+        drawPoint(renderer, game.powerUp.x + SNAKE_VELOCITY / 2, game.powerUp.y + SNAKE_VELOCITY / 2);
+    }
+
+    renderParticles(renderer, particles);
+    drawOrigin = {0, 0};
+
+    if (touches(&screen, scoreBounds(game.score)))
+    {
+        SDL_Color black = {0, 0, 0, 255};
+        char message[32];
+        snprintf(message, sizeof(message), "Score: %d", game.score);
+
+        int scoreX = 1;
+        int scoreY = 1;
+        drawCachedText(renderer, scoreText, score, message, scoreX, scoreY, black);
+    }
+}
+
+void renderGame(SDL_Renderer *renderer, const GameState &game)
+{
+    renderGameRegion(renderer, game, nullptr);
+}
+
+// Incremental rendering. The playfield persists between frames (in
+// dirtyTarget on the SDL backend, in the framebuffer on the raster one) and
+// each frame repaints only the regions that changed since the last: the new
+// head, the vacated tail, segments whose colour changed, food, bonus and the
+// score, and every live particle where it was drawn last frame and where it
+// is now. The body gradient is indexed from the head, so most body segments
+// change colour every tick; when that adds up to more than DIRTY_MAX_REGIONS
+// regions or a quarter of the screen (a death explosion, say), or the view
+// of a large board scrolls, the frame is redrawn in full instead.
+const int DIRTY_MAX_REGIONS = 512;
+
+DirtyRects dirty;
+
+// Adds rect to the damage, folding it into the previous region when their
+// bounding box covers no more pixels than the two separately (a straight run
+// of body segments becomes one strip)
+void addDamage(DirtyRects &damage, const SDL_Rect &rect)
+{
+    if (!damage.regions.empty())
+    {
+        SDL_Rect &last = damage.regions.back();
+        SDL_Rect merged;
+        SDL_UnionRect(&last, &rect, &merged);
+        if ((long long)merged.w * merged.h <= (long long)last.w * last.h + (long long)rect.w * rect.h)
+        {
+            last = merged;
+            return;
+        }
+    }
+    damage.regions.push_back(rect);
+}
+
+void addBoardDamage(DirtyRects &damage, const SDL_Rect &rect)
+{
+    addDamage(damage, {rect.x + damage.origin.x, rect.y + damage.origin.y, rect.w, rect.h});
+}
+
+// Adds the snake's damage since the last frame, or returns false when the
+// change is not a single move (a new game, or the first frame).
+bool collectSnakeDamage(DirtyRects &damage, const SnakeBody &snake)
+{
+    const SnakeBody &last = damage.snake;
+    size_t n = snake.size(), m = last.size();
+    if (m == 0 || (n != m && n != m + 1))
+    {
+        return false;
+    }
+    if (n == m && snake[0].x == last[0].x && snake[0].y == last[0].y)
+    {
+        return true; // did not move
+    }
+
+    // Every segment but the new head is where the one before it was
+    for (size_t i = 1; i < n; i++)
+    {
+        if (snake[i].x != last[i - 1].x || snake[i].y != last[i - 1].y)
+        {
+            return false;
+        }
+    }
+
+    addBoardDamage(damage, segmentBounds(snake[0]));
+    for (size_t i = 1; i < n; i++)
+    {
+        if (segmentStyle(i) != segmentStyle(i - 1))
+        {
+            addBoardDamage(damage, segmentBounds(snake[i]));
+        }
+    }
+    if (n == m)
+    {
+        addBoardDamage(damage, segmentBounds(last[m - 1]));
+    }
+    return true;
+}
+
+void renderGameDirty(SDL_Renderer *renderer, const GameState &game)
+{
+    const SDL_Rect screen = {0, 0, SCREEN_WIDTH, SCREEN_HEIGHT};
+    SDL_Rect food = foodBounds(game), powerUp = powerUpBounds(game);
+    SDL_Rect bonus = bonusFoodBounds(game), countdown = bonusCountdownBounds(game);
+    SDL_UnionRect(&bonus, &countdown, &bonus);
+    SDL_Point origin = boardOrigin(game);
+    dirty.regions.clear();
+
+    bool full = !dirty.valid || dirty.particlesOverflow || particles.count > DIRTY_MAX_REGIONS ||
+                game.obstaclesDown != dirty.obstaclesDown ||
+                origin.x != dirty.origin.x || origin.y != dirty.origin.y || !collectSnakeDamage(dirty, game.snake);
+    if (!full)
+    {
+        if (!SDL_RectEquals(&food, &dirty.food))
+        {
+            addBoardDamage(dirty, dirty.food);
+            addBoardDamage(dirty, food);
+        }
+        if (game.bonusFoodActive != dirty.bonusFoodActive || (game.bonusFoodActive && !SDL_RectEquals(&bonus, &dirty.bonusFood)))
+        {
+            if (dirty.bonusFoodActive)
+                addBoardDamage(dirty, dirty.bonusFood);
+            if (game.bonusFoodActive)
+                addBoardDamage(dirty, bonus);
+        }
+        else if (game.bonusFoodActive && game.bonusExpires != 0)
+        {
+            addBoardDamage(dirty, countdown);
+        }
+        if (game.powerUpKind != dirty.powerUpKind || (game.powerUpKind != POWER_NONE && !SDL_RectEquals(&powerUp, &dirty.powerUp)))
+        {
+            if (dirty.powerUpKind != POWER_NONE)
+                addBoardDamage(dirty, dirty.powerUp);
+            if (game.powerUpKind != POWER_NONE)
+                addBoardDamage(dirty, powerUp);
+        }
+        if (game.score != dirty.score)
+        {
+            addDamage(dirty, scoreBounds(dirty.score));
+            addDamage(dirty, scoreBounds(game.score));
+        }
+        for (const SDL_Rect &bounds : dirty.particles)
+        {
+            addBoardDamage(dirty, bounds);
+        }
+        for (int i = 0; i < particles.count; i++)
+        {
+            addBoardDamage(dirty, particleBounds(particles, i));
+        }
+    }
+
+    long long area = 0;
+    for (SDL_Rect &region : dirty.regions)
+    {
+        if (!SDL_IntersectRect(&region, &screen, &region))
+        {
+            region = {0, 0, 0, 0};
+        }
+        area += (long long)region.w * region.h;
+    }
+    full = full || dirty.regions.size() > (size_t)DIRTY_MAX_REGIONS || area > (long long)SCREEN_WIDTH * SCREEN_HEIGHT / 4;
+
+    if (dirtyTarget != nullptr)
+    {
+        SDL_SetRenderTarget(renderer, dirtyTarget);
+    }
+
+    if (full)
+    {
+        renderGame(renderer, game);
+        area = (long long)SCREEN_WIDTH * SCREEN_HEIGHT;
+        dirty.fullRedraws++;
+    }
+    else
+    {
+        for (const SDL_Rect &region : dirty.regions)
+        {
+            if (region.w > 0)
+            {
+                setClipRect(renderer, &region);
+                renderGameRegion(renderer, game, &region);
+            }
+        }
+        setClipRect(renderer, nullptr);
+    }
+
+    if (dirtyTarget != nullptr)
+    {
+        SDL_SetRenderTarget(renderer, nullptr);
+        SDL_RenderCopy(renderer, dirtyTarget, nullptr, nullptr);
+    }
+
+    dirty.frames++;
+    dirty.pixels += area;
+    dirty.valid = true;
+    dirty.origin = origin;
+    dirty.snake.copyFrom(game.snake); // capacity is kept, so this stops allocating
+    dirty.food = food;
+    dirty.bonusFoodActive = game.bonusFoodActive;
+    dirty.bonusFood = bonus;
+    dirty.powerUpKind = game.powerUpKind;
+    dirty.powerUp = powerUp;
+    dirty.obstaclesDown = game.obstaclesDown;
+    dirty.score = game.score;
+    dirty.particles.reserve(DIRTY_MAX_REGIONS);
+    dirty.particles.clear();
+    dirty.particlesOverflow = particles.count > DIRTY_MAX_REGIONS;
+    for (int i = 0; i < particles.count && !dirty.particlesOverflow; i++)
+    {
+        dirty.particles.push_back(particleBounds(particles, i));
+    }
+}
+
+// Draws the playfield for the playing scene, incrementally when enabled
+void renderPlaying(SDL_Renderer *renderer, const GameState &game)
+{
+    if (dirtyRectMode)
+    {
+        renderGameDirty(renderer, game);
+    }
+    else
+    {
+        renderGame(renderer, game);
+    }
+}
+
+void reportDirtyRects()
+{
+    if (dirty.frames == 0)
+    {
+        return;
+    }
+    double perFrame = (double)dirty.pixels / dirty.frames;
+    cout << "Dirty rects: " << perFrame << " pixels repainted per frame (" << perFrame * 100.0 / (SCREEN_WIDTH * SCREEN_HEIGHT)
+         << "% of full redraw), " << dirty.fullRedraws << " of " << dirty.frames << " frames redrawn in full" << endl;
+}
+
+// Debug overlay with the last frame's allocations, toggled by F3 while
+// playing. Its own text is counted under "overlay", not "text".
+void renderAllocationOverlay(SDL_Renderer *renderer)
+{
+    AllocationScope scope(ALLOC_OVERLAY);
+    const AllocationFrame &last = allocations.last;
+    SDL_Color white = {255, 255, 255, 255};
+
+    SDL_Rect box = {0, SCREEN_HEIGHT - 44, SCREEN_WIDTH, 44};
+    setDrawColor(renderer, 0, 0, 0, 255);
+    fillRect(renderer, &box);
+
+    char line[192];
+    snprintf(line, sizeof(line), "Allocations last frame: %llu (%llu bytes), peak %llu", (unsigned long long)last.totalCount,
+             (unsigned long long)last.totalBytes, (unsigned long long)allocations.peakCount);
+    scoreRenderText(renderer, line, 4, box.y + 2, white);
+
+    int length = 0;
+    for (int s = 0; s < ALLOC_SUBSYSTEMS && length < (int)sizeof(line); s++)
+    {
+        length += snprintf(line + length, sizeof(line) - length, "%s%s %llu", s > 0 ? "   " : "", allocationNames[s],
+                           (unsigned long long)last.count[s]);
+    }
+    scoreRenderText(renderer, line, 4, box.y + 22, white);
+
+    // The raster framebuffer doubles as the dirty-rect target, which the
+    // overlay has now drawn over
+    if (renderBackend == BACKEND_RASTER)
+    {
+        dirty.valid = false;
+    }
+}
+
+void updateCursor(bool overButton)
+{
+    SDL_SetCursor(overButton ? handCursor : arrowCursor);
+}
+
+void renderMenu(SDL_Renderer *renderer)
+{
+    SDL_Color white = {255, 255, 255, 255};
+    SDL_Color black = {0, 0, 0, 255};
+
+    renderBackground(renderer, coverImage);
+    renderStartButton(renderer, menuStartButton.x, menuStartButton.y, menuStartButton.w, menuStartButton.h, black);
+    renderExitButton(renderer, menuExitButton.x, menuExitButton.y, menuExitButton.w, menuExitButton.h, white);
+
+    if (levels.size() > 1)
+    {
+        string levelText = "<  Level: " + string(levels[currentLevel].header->name) + "  >";
+        renderText(renderer, levelText.c_str(), menuExitButton.x, menuExitButton.y + 90, white);
+    }
+}
+
+void renderPaused(SDL_Renderer *renderer, const GameState &game)
+{
+    SDL_Color red = {255, 0, 0, 255};
+
+    renderGame(renderer, game);
+    renderText(renderer, "WARNING!. Press Y to continue or N to quit.", SCREEN_WIDTH / 2 - 320, SCREEN_HEIGHT / 2, red);
+}
+
+void renderGameOver(SDL_Renderer *renderer, const GameState &game)
+{
+    SDL_Color orange = {255, 165, 0, 255};
+
+    renderGame(renderer, game);
+    renderGameOverButton(renderer, gameOverButton.x, gameOverButton.y, gameOverButton.w, gameOverButton.h, orange);
+}
+
+void renderFinalScore(SDL_Renderer *renderer, const GameState &game)
+{
+    SDL_Color white = {255, 255, 255, 255};
+    SDL_Color black = {0, 0, 0, 255};
+
+    renderBackground(renderer, gameOverScreenImage);
+
+    char message[32];
+    snprintf(message, sizeof(message), "Final  Score: %d", game.score);
+    finalScoreRenderText(renderer, message, SCREEN_WIDTH / 2 - 165, SCREEN_HEIGHT / 2 + 20, black);
+
+    renderRestartButton(renderer, restartButton.x, restartButton.y, restartButton.w, restartButton.h, black);
+    renderExitButton(renderer, finalExitButton.x, finalExitButton.y, finalExitButton.w, finalExitButton.h, white);
+}
+
+bool isMouseOver(int mouseX, int mouseY, const SDL_Rect &button)
+{
+    return isMouseOverButton(mouseX, mouseY, button.x, button.y, button.w, button.h);
+}
+
+// Pipelined play (--pipelined). The simulation runs on its own thread on a
+// fixed tick schedule and publishes every tick as a FrameSnapshot through a
+// lock-free triple buffer; the SDL thread keeps input, effects, sound and
+// rendering and always draws the newest complete snapshot, so a slow present
+// delays frames but never ticks. Key presses reach the simulation through a
+// FrameQueue ring. Eats, bonuses, pickups and collisions go the other way
+// through a TickEvent ring, one entry per tick with where it happened, so
+// the SDL thread plays every one in order even when it draws only the
+// newest of several snapshots. The thread is started once and parked
+// between games: the GameState belongs to it from startSimulation until
+// stopSimulation returns.
+const Uint32 PIPELINE_FRAME_MS = 16;
+const int SNAPSHOT_FRESH = 4; // on middle until the reader takes it
+
+enum SimulationState
+{
+    SIM_IDLE, // parked; the SDL thread owns the game
+    SIM_RUN,
+    SIM_STOP // asked to park
+};
+
+// One published tick. game holds only what rendering and effects read.
+struct FrameSnapshot
+{
+    GameState game;
+    Uint64 tick = 0;
+};
+
+// A tick that ate, took a pickup or collided, with the head and bonus
+// positions it left
+struct TickEvent
+{
+    Uint64 tick;
+    TickResult result;
+    SnakeSegment head;
+    SDL_Point bonusFood;
+};
+
+struct TickEventQueue
+{
+    static const unsigned CAPACITY = 64; // power of two
+    TickEvent slots[CAPACITY];
+    std::atomic<unsigned> head{0};
+    std::atomic<unsigned> tail{0};
+};
+
+// Simulation side. A full ring (the SDL thread 64 eventful ticks behind)
+// drops the event, which pipelineEvents then shows as sent but not played.
+bool pushTickEvent(TickEventQueue &queue, const TickEvent &event)
+{
+    unsigned tail = queue.tail.load(std::memory_order_relaxed);
+    if (tail - queue.head.load(std::memory_order_acquire) == TickEventQueue::CAPACITY)
+    {
+        return false;
+    }
+    queue.slots[tail % TickEventQueue::CAPACITY] = event;
+    queue.tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+// SDL thread side: takes the oldest event if it is from tick upTo or before
+bool popTickEvent(TickEventQueue &queue, Uint64 upTo, TickEvent &event)
+{
+    unsigned head = queue.head.load(std::memory_order_relaxed);
+    if (head == queue.tail.load(std::memory_order_acquire) || queue.slots[head % TickEventQueue::CAPACITY].tick > upTo)
+    {
+        return false;
+    }
+    event = queue.slots[head % TickEventQueue::CAPACITY];
+    queue.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+struct Pipeline
+{
+    FrameSnapshot slots[3];
+    std::atomic<int> middle{1};
+    int back = 0;          // simulation's slot
+    int front = 2;         // SDL thread's slot
+    FrameQueue keys;       // key codes, SDL thread -> simulation
+    TickEventQueue events; // simulation -> SDL thread
+    std::thread simulation;
+    std::atomic<int> state{SIM_IDLE};
+    std::atomic<bool> exiting{false};
+    bool active = false; // SDL thread side: a game is handed over
+    GameState *game = nullptr;
+    Uint64 ticks = 0;
+};
+
+Pipeline pipeline;
+PipelineEvents pipelineEvents;
+TickJitter tickJitter;
+FrameTimes frameTimes;
+bool pipelinedMode = false;
+bool autopilot = false;
+Uint32 slowRenderMs = 0;
+
+void measureTickStart(TickJitter &jitter, Uint64 now)
+{
+    if (jitter.last != 0)
+    {
+        double elapsedMs = (now - jitter.last) * 1000.0 / SDL_GetPerformanceFrequency();
+        double deviation = fabs(elapsedMs - jitter.intervalMs);
+        jitter.ticks++;
+        jitter.totalMs += deviation;
+        jitter.worstMs = max(jitter.worstMs, deviation);
+    }
+    jitter.last = now;
+}
+
+void measureFrame(FrameTimes &times, Uint64 start)
+{
+    double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+    times.frames++;
+    times.totalMs += ms;
+    times.worstMs = max(times.worstMs, ms);
+}
+
+void reportPlayTiming()
+{
+    if (tickJitter.ticks == 0 && frameTimes.frames == 0)
+    {
+        return;
+    }
+    cout << (pipelinedMode ? "Pipelined" : "Serial") << " play";
+    if (slowRenderMs > 0)
+    {
+        cout << " (rendering slowed by " << slowRenderMs << " ms)";
+    }
+    cout << ": " << tickJitter.ticks << " ticks, jitter " << (tickJitter.ticks > 0 ? tickJitter.totalMs / tickJitter.ticks : 0.0)
+         << " ms average, " << tickJitter.worstMs << " ms worst; " << frameTimes.frames << " frames, "
+         << (frameTimes.frames > 0 ? frameTimes.totalMs / frameTimes.frames : 0.0) << " ms average, " << frameTimes.worstMs
+         << " ms worst" << endl;
+}
+
+// The snake's capacity is reserved up front, so this does not allocate
+void copyRenderState(GameState &snapshot, const GameState &game)
+{
+    snapshot.snake.copyFrom(game.snake);
+    snapshot.dirX = game.dirX;
+    snapshot.dirY = game.dirY;
+    snapshot.food = game.food;
+    snapshot.bonusFoodActive = game.bonusFoodActive;
+    snapshot.bonusFood = game.bonusFood;
+    snapshot.score = game.score;
+    snapshot.level = game.level;
+    snapshot.timers.now = game.timers.now;
+    snapshot.bonusExpires = game.bonusExpires;
+    snapshot.powerUpKind = game.powerUpKind;
+    snapshot.powerUp = game.powerUp;
+    snapshot.speed = game.speed;
+    snapshot.obstaclesDown = game.obstaclesDown;
+}
+
+// Simulation side: queues what the tick did, then fills the back slot and
+// swaps it into the middle. The event goes first, so whichever snapshot the
+// reader takes, every event up to its tick is already queued.
+void publishSnapshot(const GameState &game, const TickResult &result)
+{
+    Uint64 tick = ++pipeline.ticks;
+    if (result.ateFood || result.ateBonus || result.powerUp != POWER_NONE || result.collision != COLLISION_NONE)
+    {
+        TickEvent event = {tick, result, game.snake[0], game.bonusFood};
+        pipelineEvents.sent++;
+        pushTickEvent(pipeline.events, event);
+    }
+
+    FrameSnapshot &snapshot = pipeline.slots[pipeline.back];
+    copyRenderState(snapshot.game, game);
+    snapshot.tick = tick;
+    int previous = pipeline.middle.exchange(pipeline.back | SNAPSHOT_FRESH, std::memory_order_acq_rel);
+    pipeline.back = previous & 3;
+}
+
+// SDL thread side: takes the newest snapshot into the front slot, or returns
+// false if nothing was published since the last call
+bool acquireSnapshot()
+{
+    if ((pipeline.middle.load(std::memory_order_acquire) & SNAPSHOT_FRESH) == 0)
+    {
+        return false;
+    }
+    int previous = pipeline.middle.exchange(pipeline.front, std::memory_order_acq_rel);
+    pipeline.front = previous & 3;
+    return true;
+}
+
+void emitTickTelemetry(const GameState &game, const TickResult &result, Uint64 tickCounts)
+{
+    emitTelemetry(TELEMETRY_TICK, (Sint32)game.snake.size(), (Sint64)(tickCounts * 1000000000 / SDL_GetPerformanceFrequency()));
+    if (result.ateFood)
+    {
+        emitTelemetry(TELEMETRY_EAT, game.score, (Sint64)game.snake.size());
+    }
+    if (result.spawnedBonus)
+    {
+        emitTelemetry(TELEMETRY_BONUS_SPAWN, game.bonusFood.x, game.bonusFood.y);
+    }
+    if (result.ateBonus)
+    {
+        emitTelemetry(TELEMETRY_BONUS_EAT, game.score);
+    }
+    if (result.collision != COLLISION_NONE)
+    {
+        emitTelemetry(TELEMETRY_COLLISION, result.collision, game.score);
+    }
+}
+
+void playTickSounds(const TickResult &result)
+{
+    AllocationScope scope(ALLOC_AUDIO);
+    if (result.collision == COLLISION_WALL || result.collision == COLLISION_SELF)
+    {
+        Mix_HaltMusic();
+        Mix_PlayChannel(-1, gameOverSound, 0);
+        return;
+    }
+
+    if (result.ateFood)
+    {
+        Mix_PlayChannel(-1, eatingSound, 0);
+    }
+
+    if (result.ateBonus || result.powerUp != POWER_NONE)
+    {
+        Mix_PlayChannel(-1, bonusEatingSound, 0);
+    }
+}
+
+// Ticks on schedule until asked to stop or the game hits something. Sleeps
+// in short slices so a stop request is seen within a frame.
+void runSimulation(GameState &game)
+{
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point due = Clock::now();
+    while (pipeline.state.load(std::memory_order_acquire) == SIM_RUN)
+    {
+        Clock::time_point now = Clock::now();
+        if (now < due)
+        {
+            std::this_thread::sleep_until(min(due, now + std::chrono::milliseconds(PIPELINE_FRAME_MS)));
+            continue;
+        }
+
+        Uint64 tickStart = SDL_GetPerformanceCounter();
+        measureTickStart(tickJitter, tickStart);
+        int key;
+        while (popFrame(pipeline.keys, key))
+        {
+            steerSnake(game, key);
+        }
+        if (autopilot)
+        {
+            steerSnake(game, autopilotKey(game));
+        }
+
+        recordTick(game);
+        TickResult result;
+        {
+            AllocationScope scope(ALLOC_SIMULATION);
+            result = tickGame(game);
+        }
+        emitTickTelemetry(game, result, SDL_GetPerformanceCounter() - tickStart);
+        publishSnapshot(game, result);
+        if (result.collision != COLLISION_NONE)
+        {
+            return;
+        }
+
+        // More than a whole tick behind (the machine stalled): skip ahead
+        // instead of ticking in a burst
+        tickJitter.intervalMs = tickDelayMs(game);
+        due += std::chrono::milliseconds(tickJitter.intervalMs);
+        if (Clock::now() - due > std::chrono::milliseconds(tickJitter.intervalMs))
+        {
+            due = Clock::now();
+        }
+    }
+}
+
+void simulationLoop()
+{
+    while (!pipeline.exiting.load(std::memory_order_acquire))
+    {
+        if (pipeline.state.load(std::memory_order_acquire) != SIM_RUN)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        runSimulation(*pipeline.game);
+        pipeline.state.store(SIM_IDLE, std::memory_order_release);
+    }
+}
+
+// Hands game to the simulation thread, starting the thread the first time
+void startSimulation(GameState &game)
+{
+    for (FrameSnapshot &slot : pipeline.slots)
+    {
+        slot.game.snake.reserve(game.snake.capacity());
+        slot.tick = 0;
+    }
+    pipeline.back = 0;
+    pipeline.middle.store(1, std::memory_order_relaxed);
+    pipeline.front = 2;
+    pipeline.ticks = 0;
+    pipelineEvents = PipelineEvents();
+    copyRenderState(pipeline.slots[pipeline.front].game, game);
+
+    // Keys pressed while no game was running are stale, and so is anything
+    // the last game queued after a stop request
+    int key;
+    while (popFrame(pipeline.keys, key))
+    {
+    }
+    TickEvent event;
+    while (popTickEvent(pipeline.events, UINT64_MAX, event))
+    {
+    }
+
+    pipeline.game = &game;
+    pipeline.active = true;
+    pipeline.state.store(SIM_RUN, std::memory_order_release);
+    if (!pipeline.simulation.joinable())
+    {
+        pipeline.simulation = std::thread(simulationLoop);
+    }
+}
+
+// Parks the simulation; the game is the SDL thread's again on return
+void stopSimulation()
+{
+    int running = SIM_RUN;
+    pipeline.state.compare_exchange_strong(running, SIM_STOP, std::memory_order_acq_rel);
+    while (pipeline.state.load(std::memory_order_acquire) != SIM_IDLE)
+    {
+        std::this_thread::yield();
+    }
+    pipeline.active = false;
+}
+
+void shutdownSimulation()
+{
+    if (!pipeline.simulation.joinable())
+    {
+        return;
+    }
+    stopSimulation();
+    pipeline.exiting.store(true, std::memory_order_release);
+    pipeline.simulation.join();
+    pipeline.exiting.store(false, std::memory_order_relaxed);
+}
+
+// How long the scene loop waits before running scene again
+Uint32 sceneDelayMs(Scene scene, const GameState &game)
+{
+    if (scene != SCENE_PLAYING)
+    {
+        return 16;
+    }
+    // Pipelined, the game belongs to the simulation thread: do not read it
+    return pipelinedMode ? PIPELINE_FRAME_MS : tickDelayMs(game);
+}
+
+Scene menuScene(SDL_Renderer *renderer)
+{
+    const SDL_Rect &startRect = menuStartButton;
+    const SDL_Rect &exitRect = menuExitButton;
+
+    SDL_Event e;
+    while (SDL_PollEvent(&e) != 0)
+    {
+        if (e.type == SDL_QUIT)
+        {
+            return SCENE_QUIT;
+        }
+        else if (e.type == SDL_MOUSEMOTION)
+        {
+            updateCursor(isMouseOver(e.motion.x, e.motion.y, startRect) || isMouseOver(e.motion.x, e.motion.y, exitRect));
+        }
+        else if (e.type == SDL_KEYDOWN && (e.key.keysym.sym == SDLK_LEFT || e.key.keysym.sym == SDLK_RIGHT))
+        {
+            size_t step = e.key.keysym.sym == SDLK_RIGHT ? 1 : levels.size() - 1;
+            currentLevel = (currentLevel + step) % levels.size();
+        }
+        else if (e.type == SDL_MOUSEBUTTONUP && e.button.button == SDL_BUTTON_LEFT)
+        {
+            int mouseX = e.button.x;
+            int mouseY = e.button.y;
+
+            if (handleStartButtonClick(mouseX, mouseY, startRect.x, startRect.y, startRect.w, startRect.h))
+            {
+                return SCENE_PLAYING;
+            }
+            else if (handleExitButtonClick(mouseX, mouseY, exitRect.x, exitRect.y, exitRect.w, exitRect.h))
+            {
+                return SCENE_QUIT;
+            }
+        }
+    }
+
+    AllocationScope scope(ALLOC_RENDER);
+    renderMenu(renderer);
+    presentFrame(renderer);
+
+    return SCENE_MENU;
+}
+
+Scene playingScene(SDL_Renderer *renderer, GameState &game)
+{
+    SDL_Event e;
+    while (SDL_PollEvent(&e) != 0)
+    {
+        if (e.type == SDL_QUIT)
+        {
+            return SCENE_QUIT;
+        }
+        else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3)
+        {
+            allocations.overlay = allocationCounting && !allocations.overlay;
+        }
+        else if (e.type == SDL_KEYDOWN)
+        {
+            steerSnake(game, e.key.keysym.sym);
+        }
+    }
+    if (autopilot)
+    {
+        steerSnake(game, autopilotKey(game));
+    }
+
+    recordTick(game);
+    Uint64 tickStart = SDL_GetPerformanceCounter();
+    measureTickStart(tickJitter, tickStart);
+    TickResult result;
+    {
+        AllocationScope scope(ALLOC_SIMULATION);
+        result = tickGame(game);
+    }
+    emitTickTelemetry(game, result, SDL_GetPerformanceCounter() - tickStart);
+    tickJitter.intervalMs = tickDelayMs(game);
+    {
+        AllocationScope scope(ALLOC_EFFECTS);
+        emitTickEffects(particles, game, result);
+    }
+
+    playTickSounds(result);
+    if (result.collision == COLLISION_WALL || result.collision == COLLISION_SELF)
+    {
+        return SCENE_GAME_OVER;
+    }
+
+    Uint64 frameStart = SDL_GetPerformanceCounter();
+    {
+        AllocationScope scope(ALLOC_EFFECTS);
+        advanceParticles(particles);
+    }
+    AllocationScope renderScope(ALLOC_RENDER);
+    renderPlaying(renderer, game);
+    if (allocations.overlay)
+    {
+        renderAllocationOverlay(renderer);
+    }
+    presentFrame(renderer);
+    SDL_Delay(slowRenderMs);
+    measureFrame(frameTimes, frameStart);
+
+    return result.collision == COLLISION_OBSTACLE ? SCENE_PAUSED : SCENE_PLAYING;
+}
+
+// The playing scene with the simulation on its own thread: forwards keys,
+// plays every event up to the newest snapshot and draws it
+Scene pipelinedPlayingScene(SDL_Renderer *renderer, GameState &game)
+{
+    if (!pipeline.active)
+    {
+        startSimulation(game);
+    }
+
+    SDL_Event e;
+    while (SDL_PollEvent(&e) != 0)
+    {
+        if (e.type == SDL_QUIT)
+        {
+            stopSimulation();
+            return SCENE_QUIT;
+        }
+        else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3)
+        {
+            allocations.overlay = allocationCounting && !allocations.overlay;
+        }
+        else if (e.type == SDL_KEYDOWN)
+        {
+            pushFrame(pipeline.keys, e.key.keysym.sym);
+        }
+    }
+
+    Uint64 frameStart = SDL_GetPerformanceCounter();
+    Scene next = SCENE_PLAYING;
+    if (acquireSnapshot())
+    {
+        const FrameSnapshot &snapshot = pipeline.slots[pipeline.front];
+        Collision collision = COLLISION_NONE;
+        int played = 0;
+        TickEvent event;
+        while (popTickEvent(pipeline.events, snapshot.tick, event))
+        {
+            {
+                AllocationScope scope(ALLOC_EFFECTS);
+                emitPickupEffects(particles, event.head, event.bonusFood, event.result);
+            }
+            playTickSounds(event.result);
+            collision = event.result.collision;
+            played++;
+        }
+        pipelineEvents.played += played;
+        pipelineEvents.batched += played > 1;
+
+        if (collision != COLLISION_NONE)
+        {
+            // A collision is always the last tick, so the snapshot is the
+            // body that blows up. The simulation has parked itself.
+            stopSimulation();
+            AllocationScope scope(ALLOC_EFFECTS);
+            emitTickEffects(particles, snapshot.game, {collision, false, false, false, POWER_NONE, false, false});
+            if (collision != COLLISION_OBSTACLE)
+            {
+                return SCENE_GAME_OVER;
+            }
+            next = SCENE_PAUSED;
+        }
+    }
+
+    {
+        AllocationScope scope(ALLOC_EFFECTS);
+        advanceParticles(particles);
+    }
+    AllocationScope renderScope(ALLOC_RENDER);
+    renderPlaying(renderer, pipeline.slots[pipeline.front].game);
+    if (allocations.overlay)
+    {
+        renderAllocationOverlay(renderer);
+    }
+    presentFrame(renderer);
+    SDL_Delay(slowRenderMs);
+    measureFrame(frameTimes, frameStart);
+
+    return next;
+}
+
+Scene pausedScene(SDL_Renderer *renderer, const GameState &game)
+{
+    SDL_Event e;
+    while (SDL_PollEvent(&e) != 0)
+    {
+        if (e.type == SDL_QUIT)
+        {
+            return SCENE_QUIT;
+        }
+        else if (e.type == SDL_KEYDOWN)
+        {
+            if (e.key.keysym.sym == SDLK_y)
+            {
+                return SCENE_PLAYING;
+            }
+            else if (e.key.keysym.sym == SDLK_n)
+            {
+                return SCENE_GAME_OVER;
+            }
+        }
+    }
+
+    AllocationScope scope(ALLOC_RENDER);
+    renderPaused(renderer, game);
+    presentFrame(renderer);
+
+    return SCENE_PAUSED;
+}
+
+Scene gameOverScene(SDL_Renderer *renderer, const GameState &game)
+{
+    const SDL_Rect &overRect = gameOverButton;
+
+    SDL_Event e;
+    while (SDL_PollEvent(&e) != 0)
+    {
+        if (e.type == SDL_QUIT)
+        {
+            return SCENE_QUIT;
+        }
+        else if (e.type == SDL_MOUSEMOTION)
+        {
+            updateCursor(isMouseOver(e.motion.x, e.motion.y, overRect));
+        }
+        else if (e.type == SDL_MOUSEBUTTONUP && e.button.button == SDL_BUTTON_LEFT)
+        {
+            if (handleGameOverButtonClick(e.button.x, e.button.y, overRect.x, overRect.y, overRect.w, overRect.h))
+            {
+                return SCENE_FINAL_SCORE;
+            }
+        }
+    }
+
+    {
+        AllocationScope scope(ALLOC_EFFECTS);
+        advanceParticles(particles);
+    }
+    AllocationScope scope(ALLOC_RENDER);
+    renderGameOver(renderer, game);
+    presentFrame(renderer);
+
+    return SCENE_GAME_OVER;
+}
+
+Scene finalScoreScene(SDL_Renderer *renderer, const GameState &game)
+{
+    const SDL_Rect &restartRect = restartButton;
+    const SDL_Rect &exitRect = finalExitButton;
+
+    SDL_Event e;
+    while (SDL_PollEvent(&e) != 0)
+    {
+        if (e.type == SDL_QUIT)
+        {
+            return SCENE_QUIT;
+        }
+        else if (e.type == SDL_MOUSEMOTION)
+        {
+            updateCursor(isMouseOver(e.motion.x, e.motion.y, restartRect) || isMouseOver(e.motion.x, e.motion.y, exitRect));
+        }
+        else if (e.type == SDL_MOUSEBUTTONUP && e.button.button == SDL_BUTTON_LEFT)
+        {
+            int mouseX = e.button.x;
+            int mouseY = e.button.y;
+
+            if (handleRestartButtonClick(mouseX, mouseY, restartRect.x, restartRect.y, restartRect.w, restartRect.h))
+            {
+                return SCENE_PLAYING;
+            }
+            else if (handleExitButtonClick(mouseX, mouseY, exitRect.x, exitRect.y, exitRect.w, exitRect.h))
+            {
+                return SCENE_QUIT;
+            }
+        }
+    }
+
+    AllocationScope scope(ALLOC_RENDER);
+    renderFinalScore(renderer, game);
+    presentFrame(renderer);
+
+    return SCENE_FINAL_SCORE;
+}
+
+// Runs the whole game as a flat state machine on the one window/renderer
+// created by initializeSDL. Restarting is a transition back to SCENE_PLAYING,
+// never a nested call, so the stack and the loaded assets stay the same size.
+void runScenes(SDL_Renderer *renderer)
+{
+    GameState game;
+    resetGame(game, levels[currentLevel], rand(), gameRules);
+
+    Scene scene = SCENE_MENU;
+    SDL_SetCursor(arrowCursor);
+    resetAllocationFrame(); // loading is not a frame
+
+    Uint64 restartStart = 0;
+    int restarts = 0;
+    double restartTotalMs = 0, restartWorstMs = 0;
+
+    while (scene != SCENE_QUIT)
+    {
+        Scene next = SCENE_QUIT;
+        switch (scene)
+        {
+        case SCENE_MENU:
+            next = menuScene(renderer);
+            break;
+        case SCENE_PLAYING:
+            next = pipelinedMode ? pipelinedPlayingScene(renderer, game) : playingScene(renderer, game);
+            break;
+        case SCENE_PAUSED:
+            next = pausedScene(renderer, game);
+            break;
+        case SCENE_GAME_OVER:
+            next = gameOverScene(renderer, game);
+            break;
+        case SCENE_FINAL_SCORE:
+            next = finalScoreScene(renderer, game);
+            break;
+        case SCENE_QUIT:
+            break;
+        }
+        endAllocationFrame(sceneNames[scene]);
+
+        if (launchCounter != 0)
+        {
+            double ms = (SDL_GetPerformanceCounter() - launchCounter) * 1000.0 / SDL_GetPerformanceFrequency();
+            cout << "First menu frame after " << ms << " ms ("
+                 << (assets.header != nullptr ? "asset bundle" : "loose files") << ")" << endl;
+            launchCounter = 0;
+        }
+
+        if (restartStart != 0 && scene == SCENE_PLAYING)
+        {
+            double ms = (SDL_GetPerformanceCounter() - restartStart) * 1000.0 / SDL_GetPerformanceFrequency();
+            restarts++;
+            restartTotalMs += ms;
+            restartWorstMs = max(restartWorstMs, ms);
+            restartStart = 0;
+        }
+
+        if (next == scene)
+        {
+            SDL_Delay(sceneDelayMs(scene, game));
+            continue;
+        }
+
+        if (next == SCENE_PLAYING && (scene == SCENE_MENU || scene == SCENE_FINAL_SCORE))
+        {
+            if (scene == SCENE_FINAL_SCORE)
+            {
+                restartStart = SDL_GetPerformanceCounter();
+                Mix_PlayMusic(backgroundMusic, -1);
+                emitTelemetry(TELEMETRY_RESTART, game.score);
+            }
+
+            Uint32 seed = rand();
+            emitTelemetry(TELEMETRY_GAME_START, (Sint32)currentLevel, seed);
+            resetGame(game, levels[currentLevel], seed, gameRules);
+            clearParticles(particles);
+            recordGameStart(seed, levels[currentLevel], gameRules);
+        }
+
+        if (next == SCENE_QUIT)
+        {
+            emitTelemetry(TELEMETRY_QUIT, scene, game.score);
+        }
+
+        SDL_SetCursor(arrowCursor);
+        dirty.valid = false; // other scenes draw over the playfield
+        tickJitter.last = 0; // time away from play is not jitter
+        scene = next;
+    }
+    shutdownSimulation();
+
+    if (restarts > 0)
+    {
+        cout << "Restarts: " << restarts << ", average latency: " << restartTotalMs / restarts
+             << " ms, worst: " << restartWorstMs << " ms" << endl;
+    }
+}
+
+enum ReplayStep
+{
+    REPLAY_STEP_END,
+    REPLAY_STEP_ERROR,
+    REPLAY_STEP_GAME_START,
+    REPLAY_STEP_TICK
+};
+
+bool openReplay(ReplayReader &reader, const char *path)
+{
+    ifstream in(path, ios::binary);
+    reader.data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    reader.position = 5;
+    reader.playing = false;
+    const vector<Uint8> &data = reader.data;
+    if (data.size() < 5 || memcmp(data.data(), "SNKR", 4) != 0 || data[4] < 1 || data[4] > REPLAY_VERSION)
+    {
+        cout << "Not a replay file: " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+// Applies the next record to game: a game start resets it, a tick sets the
+// recorded direction and leaves running the tick to the caller, who clears
+// playing once the game is over. Bytes outside a game are skipped.
+ReplayStep readReplay(ReplayReader &reader, GameState &game)
+{
+    const vector<Uint8> &data = reader.data;
+    while (reader.position < data.size())
+    {
+        size_t i = reader.position;
+        if (data[i] != REPLAY_GAME_START)
+        {
+            reader.position++;
+            if (reader.playing)
+            {
+                applyDirectionCode(game, data[i]);
+                return REPLAY_STEP_TICK;
+            }
+            continue;
+        }
+
+        if (i + 4 >= data.size())
+        {
+            return REPLAY_STEP_END;
+        }
+        Uint32 seed = data[i + 1] | (data[i + 2] << 8) | (data[i + 3] << 16) | ((Uint32)data[i + 4] << 24);
+        i += 4;
+
+        string levelName = "classic";
+        if (data[4] >= 2)
+        {
+            if (i + 1 >= data.size() || i + 1 + data[i + 1] >= data.size())
+            {
+                return REPLAY_STEP_END;
+            }
+            levelName.assign((const char *)&data[i + 2], data[i + 1]);
+            i += 1 + data[i + 1];
+        }
+
+        Uint32 rules = RULES_CLASSIC;
+        if (data[4] >= 3)
+        {
+            if (i + 1 >= data.size())
+            {
+                return REPLAY_STEP_END;
+            }
+            rules = data[++i] & RULES_ALL;
+        }
+
+        int level = findLevel(levelName.c_str());
+        if (level < 0)
+        {
+            cout << "Replay needs level " << levelName << ", which is not in " << levelsDirectory << endl;
+            return REPLAY_STEP_ERROR;
+        }
+        resetGame(game, levels[level], seed, rules);
+        reader.position = i + 1;
+        reader.playing = true;
+        return REPLAY_STEP_GAME_START;
+    }
+    return REPLAY_STEP_END;
+}
+
+// Spectator wall (--spectate). A grid of viewports, one per game, each game
+// live under the autopilot or playing back a recording on its own tick
+// schedule. Everything on the wall is a quad textured from one shared atlas
+// (a solid texel, the segment sprite and both fruits) and tinted by its
+// vertex colour, so the whole wall goes to SDL_RenderGeometry in a single
+// call per frame. Each viewport picks its detail from its scale: glowing
+// segment sprites and fruit while a cell spans SPECTATOR_SPRITE_CELL pixels
+// or more, flat cells below that, and a single pixel per cell once a cell
+// is smaller than SPECTATOR_PIXEL_CELL. The wall holds as many games as
+// there are one-pixel viewports.
+const float SPECTATOR_SPRITE_CELL = 4.0f;
+const float SPECTATOR_PIXEL_CELL = 2.0f;
+const int SPECTATOR_GAP = 2;         // pixels between viewports
+const int SPECTATOR_CATCH_UP = 4;    // most ticks a game runs in one frame
+const long SPECTATOR_REPLAY_OFFSET = 50; // ticks between copies of one recording
+const int ATLAS_CELL = 32;
+
+// Fits the game's board into its viewport, centred, and picks the detail
+void fitSpectatorGame(SpectatorGame &g)
+{
+    const LevelHeader &board = *g.game.level->header;
+    g.scale = min((float)g.cell.w / board.width, (float)g.cell.h / board.height);
+    g.originX = g.cell.x + (g.cell.w - board.width * g.scale) / 2;
+    g.originY = g.cell.y + (g.cell.h - board.height * g.scale) / 2;
+
+    float cellPixels = SNAKE_VELOCITY * g.scale;
+    g.detail = cellPixels >= SPECTATOR_SPRITE_CELL ? DETAIL_SPRITES
+               : cellPixels >= SPECTATOR_PIXEL_CELL ? DETAIL_CELLS
+                                                    : DETAIL_PIXELS;
+}
+
+void spectatorWallSize(SDL_Renderer *renderer, int &width, int &height)
+{
+    width = SCREEN_WIDTH;
+    height = SCREEN_HEIGHT;
+    if (renderBackend == BACKEND_RASTER)
+    {
+        width = frame.width;
+        height = frame.height;
+    }
+    else
+    {
+        SDL_GetRendererOutputSize(renderer, &width, &height);
+    }
+}
+
+// Most viewports a width x height wall fits, one pixel each
+int spectatorCapacity(int width, int height)
+{
+    return ((width + SPECTATOR_GAP) / (1 + SPECTATOR_GAP)) * ((height + SPECTATOR_GAP) / (1 + SPECTATOR_GAP));
+}
+
+// Splits the window into the grid of equal viewports that shows the boards
+// largest
+void layoutSpectatorWall(SpectatorWall &wall, int width, int height)
+{
+    const int count = (int)wall.games.size();
+    const LevelHeader &board = *wall.games[0].game.level->header;
+    int bestColumns = 1;
+    float bestScale = 0;
+    for (int columns = 1; columns <= count; columns++)
+    {
+        int rows = (count + columns - 1) / columns;
+        float cellW = (float)(width - SPECTATOR_GAP * (columns - 1)) / columns;
+        float cellH = (float)(height - SPECTATOR_GAP * (rows - 1)) / rows;
+        float scale = min(cellW / board.width, cellH / board.height);
+        if (scale > bestScale)
+        {
+            bestScale = scale;
+            bestColumns = columns;
+        }
+    }
+
+    int rows = (count + bestColumns - 1) / bestColumns;
+    int cellW = (width - SPECTATOR_GAP * (bestColumns - 1)) / bestColumns;
+    int cellH = (height - SPECTATOR_GAP * (rows - 1)) / rows;
+    for (int i = 0; i < count; i++)
+    {
+        SpectatorGame &g = wall.games[i];
+        g.cell = {(i % bestColumns) * (cellW + SPECTATOR_GAP), (i / bestColumns) * (cellH + SPECTATOR_GAP), cellW, cellH};
+        fitSpectatorGame(g);
+    }
+}
+
+// The atlas is only needed by SDL_Renderer; the raster backend draws the
+// same quads as its own circles, fills and blits
+bool buildSpectatorAtlas(SpectatorWall &wall, SDL_Renderer *renderer)
+{
+    if (renderBackend == BACKEND_RASTER)
+    {
+        return true;
+    }
+
+    SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_CELL * ATLAS_SPRITES, ATLAS_CELL, 32, SDL_PIXELFORMAT_RGBA32);
+    if (atlas == nullptr)
+    {
+        cout << "Could not create the spectator atlas! SDL Error: " << SDL_GetError() << endl;
+        return false;
+    }
+
+    const float radius = ATLAS_CELL / 2.0f;
+    for (int y = 0; y < ATLAS_CELL; y++)
+    {
+        Uint32 *row = (Uint32 *)((Uint8 *)atlas->pixels + y * atlas->pitch);
+        for (int x = 0; x < ATLAS_CELL; x++)
+        {
+            float dx = x + 0.5f - radius, dy = y + 0.5f - radius;
+            row[ATLAS_SOLID * ATLAS_CELL + x] = 0xFFFFFFFF;
+            row[ATLAS_SEGMENT * ATLAS_CELL + x] = dx * dx + dy * dy <= radius * radius ? 0xFFFFFFFF : 0;
+        }
+    }
+
+    // Fruit scaled into their cells, nearest neighbour
+    const struct
     {
-        for (int h = 0; h < radius * 2; h++)
+        AtlasSprite sprite;
+        const char *path;
+    } fruits[] = {{ATLAS_FOOD, "image/normal_fruit.png"}, {ATLAS_BONUS, "image/bonus_fruit.png"}};
+    for (const auto &fruit : fruits)
+    {
+        SDL_Surface *image = loadSurface(fruit.path);
+        if (image == nullptr)
         {
-            int dx = radius - w;
-            int dy = radius - h;
-            if ((dx * dx + dy * dy) <= (radius * radius))
+            cout << "Failed to load " << fruit.path << " for the spectator atlas" << endl;
+            SDL_FreeSurface(atlas);
+            return false;
+        }
+        for (int y = 0; y < ATLAS_CELL; y++)
+        {
+            const Uint32 *src = (const Uint32 *)((const Uint8 *)image->pixels + (y * image->h / ATLAS_CELL) * image->pitch);
+            Uint32 *dst = (Uint32 *)((Uint8 *)atlas->pixels + y * atlas->pitch) + fruit.sprite * ATLAS_CELL;
+            for (int x = 0; x < ATLAS_CELL; x++)
             {
-                SDL_RenderDrawPoint(renderer, centerX + dx, centerY + dy);
+                dst[x] = src[x * image->w / ATLAS_CELL];
             }
         }
+        SDL_FreeSurface(image);
     }
+
+    wall.atlas = SDL_CreateTextureFromSurface(renderer, atlas);
+    SDL_FreeSurface(atlas);
+    if (wall.atlas == nullptr)
+    {
+        cout << "Could not create the spectator atlas texture! SDL Error: " << SDL_GetError() << endl;
+        return false;
+    }
+    SDL_SetTextureBlendMode(wall.atlas, SDL_BLENDMODE_BLEND);
+    return true;
 }
 
-void displayGameOverScreen(SDL_Renderer *renderer, int score)
+void destroySpectatorWall(SpectatorWall &wall)
 {
-    bool gameOverRunning = true;
-    SDL_Event event;
-
-    loadAndRenderImage(renderer, "image/game_over_screen.png");
-
-    SDL_Color white = {255, 255, 255, 255};
-    SDL_Color black = {0, 0, 0, 255};
-
-    string scoreText = "Final  Score: " + to_string(score);
-    finalScoreRenderText(renderer, scoreText.c_str(), SCREEN_WIDTH / 2 - 165, SCREEN_HEIGHT / 2 + 20, black);
-
-    int buttonWidth = 240, buttonHeight = 50;
-    int restartX = SCREEN_WIDTH / 2 - 120;
-    int restartY = SCREEN_HEIGHT / 2 + 70;
-
-    int exitX = SCREEN_WIDTH / 2 - 100;
-    int exitY = SCREEN_HEIGHT / 2 + 150;
-
-    SDL_Cursor *arrowCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_ARROW);
-    SDL_Cursor *handCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_HAND);
-
-    SDL_SetCursor(arrowCursor);
-
-    renderRestartButton(renderer, restartX, restartY, buttonWidth, buttonHeight, black);
-    renderExitButton(renderer, exitX, exitY, 200, buttonHeight, white);
-
-    SDL_RenderPresent(renderer);
+    SDL_DestroyTexture(wall.atlas);
+    wall.atlas = nullptr;
+    wall.games.clear();
+}
 
-    while (gameOverRunning)
+// Runs one tick of g. Live games restart on any collision, since nobody is
+// there to answer the continue prompt; recordings loop when they run out.
+void tickSpectatorGame(SpectatorWall &wall, SpectatorGame &g)
+{
+    if (g.replayed)
     {
-        while (SDL_PollEvent(&event))
+        bool rewound = false;
+        for (;;)
         {
-            if (event.type == SDL_QUIT)
+            ReplayStep step = readReplay(g.replay, g.game);
+            if (step == REPLAY_STEP_TICK)
             {
-                gameOverRunning = false;
+                break;
             }
-            else if (event.type == SDL_MOUSEMOTION)
+            if (step == REPLAY_STEP_GAME_START)
             {
-                int mouseX = event.motion.x;
-                int mouseY = event.motion.y;
-
-                bool restartButton = isMouseOverButton(mouseX, mouseY, restartX, restartY, buttonWidth, buttonHeight);
-                bool overExitButton = isMouseOverButton(mouseX, mouseY, exitX, exitY, 200, buttonHeight);
-
-                if (restartButton || overExitButton)
-                {
-                    SDL_SetCursor(handCursor);
-                }
-                else
-                {
-                    SDL_SetCursor(arrowCursor);
-                }
+                fitSpectatorGame(g);
+                continue;
             }
-            else if (event.type == SDL_MOUSEBUTTONUP && event.button.button == SDL_BUTTON_LEFT)
+            if (step == REPLAY_STEP_ERROR || rewound)
             {
-                int mouseX = event.button.x;
-                int mouseY = event.button.y;
-
-                if (handleRestartButtonClick(mouseX, mouseY, restartX, restartY, buttonWidth, buttonHeight))
-                {
-                    gameOverRunning = false;
-                    SDL_FreeCursor(arrowCursor);
-                    SDL_FreeCursor(handCursor);
-                    GameStarted(renderer);
-                }
-                else if (handleExitButtonClick(mouseX, mouseY, exitX, exitY, 200, buttonHeight))
-                {
-                    gameOverRunning = false;
-                }
+                g.stopped = true;
+                return;
             }
+            g.replay.position = 5;
+            g.replay.playing = false;
+            rewound = true;
         }
     }
-}
-
-void GameStarted(SDL_Renderer *gameRenderer)
-{
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
-
-    SDL_Window *gameWindow = SDL_CreateWindow("Snake Game", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
-    if (gameWindow == nullptr)
+    else
     {
-        cout << "Game window could not be created! SDL Error: " << SDL_GetError() << endl;
-        return;
+        steerSnake(g.game, autopilotKey(g.game));
     }
 
-    gameRenderer = SDL_CreateRenderer(gameWindow, -1, SDL_RENDERER_ACCELERATED);
-    if (gameRenderer == nullptr)
+    TickResult result = tickGame(g.game);
+    if (result.collision == COLLISION_NONE)
     {
-        cout << "Game renderer could not be created! SDL Error: " << SDL_GetError() << endl;
-        SDL_DestroyWindow(gameWindow);
         return;
     }
-
-    SDL_Texture *regularFoodTexture = IMG_LoadTexture(gameRenderer, "image/normal_fruit.png");
-    if (regularFoodTexture == nullptr)
+    if (!g.replayed)
     {
-        cout << "Failed to load regular food texture! SDL_image Error: " << IMG_GetError() << endl;
-        return;
+        g.seed += (Uint32)wall.games.size();
+        resetGame(g.game, *wall.level, g.seed, gameRules, false);
     }
-
-    SDL_Texture *bonusFoodTexture = IMG_LoadTexture(gameRenderer, "image/bonus_fruit.png");
-    if (bonusFoodTexture == nullptr)
+    else if (result.collision != COLLISION_OBSTACLE)
     {
-        cout << "Failed to load bonus food texture! SDL_image Error: " << IMG_GetError() << endl;
-        return;
+        g.replay.playing = false;
     }
+}
 
-    // Snake initialization
-    vector<SnakeSegment> snake = {{SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2}};
-    int snakeVelocity = 10;
-    int dirX = 1, dirY = 0;
-
-    const int wallThickness = 20;
-
-    // Regular food initialization
-    SDL_Rect food = {rand() % ((SCREEN_WIDTH - wallThickness * 2) / snakeVelocity) * snakeVelocity + wallThickness,
-                     rand() % ((SCREEN_HEIGHT - wallThickness * 2) / snakeVelocity) * snakeVelocity + wallThickness,
-                     10, 10};
-
-    bool bonusFoodActive = false;
-    SDL_Point bonusFood;
-    int bonusFoodRadius = 10;
-
-    int score = 0;
-
-    bool gameRunning = true;
-    SDL_Event e;
-
-    while (gameRunning)
+// count games, live on level or cycling through the recordings at
+// replayPaths. Copies of one recording start SPECTATOR_REPLAY_OFFSET ticks
+// apart so they do not move in lockstep.
+bool setupSpectatorWall(SpectatorWall &wall, SDL_Renderer *renderer, int count, const Level &level,
+                        const vector<const char *> &replayPaths)
+{
+    vector<ReplayReader> replays(replayPaths.size());
+    for (size_t r = 0; r < replayPaths.size(); r++)
     {
-        while (SDL_PollEvent(&e) != 0)
+        if (!openReplay(replays[r], replayPaths[r]))
         {
-            if (e.type == SDL_QUIT)
-            {
-                gameRunning = false;
-            }
-            else if (e.type == SDL_KEYDOWN)
-            {
-                switch (e.key.keysym.sym)
-                {
-                case SDLK_UP:
-                case SDLK_w:
-                    if (dirY == 0)
-                    {
-                        dirX = 0;
-                        dirY = -1;
-                    }
-                    break;
-                case SDLK_DOWN:
-                case SDLK_s:
-                    if (dirY == 0)
-                    {
-                        dirX = 0;
-                        dirY = 1;
-                    }
-                    break;
-                case SDLK_LEFT:
-                case SDLK_a:
-                    if (dirX == 0)
-                    {
-                        dirX = -1;
-                        dirY = 0;
-                    }
-                    break;
-                case SDLK_RIGHT:
-                case SDLK_d:
-                    if (dirX == 0)
-                    {
-                        dirX = 1;
-                        dirY = 0;
-                    }
-                    break;
-                }
-            }
+            return false;
         }
+    }
 
-        SnakeSegment newHead = {snake[0].x + dirX * snakeVelocity, snake[0].y + dirY * snakeVelocity};
+    int width, height;
+    spectatorWallSize(renderer, width, height);
+    if (count > spectatorCapacity(width, height))
+    {
+        count = spectatorCapacity(width, height);
+        cout << "Only " << count << " games fit on a " << width << "x" << height << " wall" << endl;
+    }
 
-        if (newHead.x < wallThickness || newHead.x >= SCREEN_WIDTH - wallThickness ||
-            newHead.y < wallThickness || newHead.y >= SCREEN_HEIGHT - wallThickness)
+    count = max(1, count);
+    wall.level = &level;
+    wall.nowMs = 0;
+    wall.games.clear();
+    wall.games.resize(count);
+    for (int i = 0; i < count; i++)
+    {
+        SpectatorGame &g = wall.games[i];
+        g.seed = (Uint32)i + 1;
+        g.dueMs = (double)i * TICK_MS / count;
+        if (replays.empty())
         {
-            Mix_HaltMusic();
-            Mix_PlayChannel(-1, gameOverSound, 0);
-
-            bool gameOver = true;
-            SDL_Color orange = {255, 165, 0, 255};
-
-            SDL_Cursor *arrowCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_ARROW);
-            SDL_Cursor *handCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_HAND);
-
-            SDL_SetCursor(arrowCursor);
-
-            int buttonWidth = 200, buttonHeight = 50;
-            int overX = SCREEN_WIDTH / 2 - 100;
-            int overY = SCREEN_HEIGHT / 2 - 50;
-
-            renderGameOverButton(gameRenderer, overX, overY, buttonWidth, buttonHeight, orange);
-            SDL_RenderPresent(gameRenderer);
-
-            SDL_Event event;
-            while (gameOver)
-            {
-                while (SDL_PollEvent(&event))
-                {
-                    if (event.type == SDL_QUIT)
-                    {
-                        gameOver = false;
-                    }
-                    else if (event.type == SDL_MOUSEMOTION)
-                    {
-                        int mouseX = event.motion.x;
-                        int mouseY = event.motion.y;
-
-                        bool gameOverButton = isMouseOverButton(mouseX, mouseY, overX, overY, buttonWidth, buttonHeight);
-                        if (gameOverButton)
-                        {
-                            SDL_SetCursor(handCursor);
-                        }
-                        else
-                        {
-                            SDL_SetCursor(arrowCursor);
-                        }
-                    }
-
-                    else if (event.type == SDL_MOUSEBUTTONUP && event.button.button == SDL_BUTTON_LEFT)
-                    {
-                        int mouseX = event.button.x;
-                        int mouseY = event.button.y;
-
-                        if (handleGameOverButtonClick(mouseX, mouseY, overX, overY, buttonWidth, buttonHeight))
-                        {
-                            gameOver = false;
-                            SDL_FreeCursor(arrowCursor);
-                            SDL_FreeCursor(handCursor);
-                            displayGameOverScreen(gameRenderer, score);
-                        }
-                    }
-                }
-            }
-            break;
+            resetGame(g.game, level, g.seed, gameRules, false);
+            continue;
         }
 
-        for (size_t i = 1; i < snake.size(); i++)
+        g.replayed = true;
+        g.replay = replays[i % replays.size()];
+        if (readReplay(g.replay, g.game) != REPLAY_STEP_GAME_START)
         {
-            if (newHead.x == snake[i].x && newHead.y == snake[i].y)
-            {
-                Mix_HaltMusic();
-                Mix_PlayChannel(-1, gameOverSound, 0);
-
-                bool gameOver = true;
-                SDL_Color orange = {255, 165, 0, 255};
-
-                SDL_Cursor *arrowCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_ARROW);
-                SDL_Cursor *handCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_HAND);
-
-                SDL_SetCursor(arrowCursor);
-
-                int buttonWidth = 200, buttonHeight = 50;
-                int overX = SCREEN_WIDTH / 2 - 100;
-                int overY = SCREEN_HEIGHT / 2 - 50;
-
-                renderGameOverButton(gameRenderer, overX, overY, buttonWidth, buttonHeight, orange);
-                SDL_RenderPresent(gameRenderer);
-
-                SDL_Event event;
-                while (gameOver)
-                {
-                    while (SDL_PollEvent(&event))
-                    {
-                        if (event.type == SDL_QUIT)
-                        {
-                            gameOver = false;
-                            gameRunning = false;
-                            return;
-                        }
-                        else if (event.type == SDL_MOUSEMOTION)
-                        {
-                            int mouseX = event.motion.x;
-                            int mouseY = event.motion.y;
-
-                            bool gameOverButton = isMouseOverButton(mouseX, mouseY, overX, overY, buttonWidth, buttonHeight);
-                            if (gameOverButton)
-                            {
-                                SDL_SetCursor(handCursor);
-                            }
-                            else
-                            {
-                                SDL_SetCursor(arrowCursor);
-                            }
-                        }
-                        else if (event.type == SDL_MOUSEBUTTONUP && event.button.button == SDL_BUTTON_LEFT)
-                        {
-                            int mouseX = event.button.x;
-                            int mouseY = event.button.y;
-
-                            if (handleGameOverButtonClick(mouseX, mouseY, SCREEN_WIDTH / 2 - 100, SCREEN_HEIGHT / 2 - 25, 200, 50))
-                            {
-                                gameOver = false;
-                                gameRunning = false;
-                                SDL_FreeCursor(arrowCursor);
-                                SDL_FreeCursor(handCursor);
-                                displayGameOverScreen(gameRenderer, score);
-                                return;
-                            }
-                        }
-                    }
-                }
-
-                break;
-            }
+            cout << "No game to play back in " << replayPaths[i % replays.size()] << endl;
+            return false;
         }
-
-        if (!gameRunning)
+        for (long t = 0; t < (long)(i / replays.size()) * SPECTATOR_REPLAY_OFFSET && !g.stopped; t++)
         {
-            break;
+            tickSpectatorGame(wall, g);
         }
+    }
 
-        snake.insert(snake.begin(), newHead);
+    layoutSpectatorWall(wall, width, height);
+    wall.quads.reserve((size_t)count * 64);
+    return buildSpectatorAtlas(wall, renderer);
+}
 
-        if (newHead.x == food.x && newHead.y == food.y)
+// Runs every game whose next tick is due by the wall clock advanced by
+// elapsedMs. A game that falls more than SPECTATOR_CATCH_UP ticks behind
+// drops the backlog rather than stalling the frame.
+void advanceSpectatorWall(SpectatorWall &wall, double elapsedMs)
+{
+    wall.nowMs += elapsedMs;
+    for (SpectatorGame &g : wall.games)
+    {
+        for (int ticks = 0; !g.stopped && g.dueMs <= wall.nowMs && ticks < SPECTATOR_CATCH_UP; ticks++)
         {
-            Mix_PlayChannel(-1, eatingSound, 0);
+            tickSpectatorGame(wall, g);
+            g.dueMs += tickDelayMs(g.game);
+        }
+        g.dueMs = max(g.dueMs, wall.nowMs - TICK_MS);
+    }
+}
 
-            food.x = rand() % ((SCREEN_WIDTH - wallThickness * 2) / snakeVelocity) * snakeVelocity + wallThickness;
-            food.y = rand() % ((SCREEN_HEIGHT - wallThickness * 2) / snakeVelocity) * snakeVelocity + wallThickness;
+inline void pushQuad(SpectatorWall &wall, float x, float y, float w, float h, AtlasSprite sprite, SDL_Color color)
+{
+    wall.quads.push_back({x, y, w, h, sprite, color});
+}
 
-            score += 5;
+// A board rect in window pixels, never thinner than one pixel
+void pushBoardRect(SpectatorWall &wall, const SpectatorGame &g, const SDL_Rect &rect, AtlasSprite sprite, SDL_Color color)
+{
+    pushQuad(wall, g.originX + rect.x * g.scale, g.originY + rect.y * g.scale, max(1.0f, rect.w * g.scale),
+             max(1.0f, rect.h * g.scale), sprite, color);
+}
 
-            static int foodCount = 0;
-            foodCount++;
-            if (foodCount % 5 == 0)
-            {
-                bonusFoodActive = true;
-                bonusFood.x = rand() % (SCREEN_WIDTH - wallThickness * 2 - 2 * bonusFoodRadius) + wallThickness + bonusFoodRadius;
-                bonusFood.y = rand() % (SCREEN_HEIGHT - wallThickness * 2 - 2 * bonusFoodRadius) + wallThickness + bonusFoodRadius;
-            }
+void collectSpectatorQuads(SpectatorWall &wall, const SpectatorGame &g)
+{
+    const GameState &game = g.game;
+    const Level &level = *game.level;
+    pushBoardRect(wall, g, {0, 0, level.header->width, level.header->height}, ATLAS_SOLID, {100, 150, 200, 255});
+    for (Uint32 i = 0; i < level.header->wallCount; i++)
+    {
+        pushBoardRect(wall, g, level.walls[i], ATLAS_SOLID, {180, 180, 180, 255});
+    }
+    SDL_Color obstacle = game.obstaclesDown ? SDL_Color{85, 130, 175, 255} : SDL_Color{0, 0, 0, 255};
+    for (Uint32 i = 0; i < level.header->obstacleCount; i++)
+    {
+        pushBoardRect(wall, g, level.obstacles[i], ATLAS_SOLID, obstacle);
+    }
+
+    const bool sprites = g.detail == DETAIL_SPRITES;
+    const float cell = SNAKE_VELOCITY * g.scale;
+    const float glow = 2 * g.scale;
+    for (size_t i = 0; i < game.snake.size(); i++)
+    {
+        int colorIntensity = segmentIntensity(i);
+        SDL_Color body = i == 0 ? SDL_Color{0, 255, 0, 255} : SDL_Color{0, (Uint8)colorIntensity, 0, 255};
+        float x = g.originX + game.snake[i].x * g.scale;
+        float y = g.originY + game.snake[i].y * g.scale;
+        if (sprites)
+        {
+            pushQuad(wall, x - glow, y - glow, cell + 2 * glow, cell + 2 * glow, ATLAS_SEGMENT,
+                     {0, (Uint8)(colorIntensity + 30), 0, 100});
+            pushQuad(wall, x, y, cell, cell, ATLAS_SEGMENT, body);
+        }
+        else if (g.detail == DETAIL_CELLS)
+        {
+            pushQuad(wall, x, y, cell, cell, ATLAS_SOLID, body);
         }
         else
         {
-            snake.pop_back();
+            pushQuad(wall, floorf(x), floorf(y), 1, 1, ATLAS_SOLID, body);
         }
+    }
 
-        if (bonusFoodActive)
-        {
-            int distX = newHead.x - bonusFood.x;
-            int distY = newHead.y - bonusFood.y;
-            int distance = sqrt(distX * distX + distY * distY);
+    const SDL_Color white = {255, 255, 255, 255};
+    pushBoardRect(wall, g, foodBounds(game), sprites ? ATLAS_FOOD : ATLAS_SOLID, sprites ? white : SDL_Color{220, 40, 40, 255});
+    if (game.bonusFoodActive)
+    {
+        pushBoardRect(wall, g, bonusFoodBounds(game), sprites ? ATLAS_BONUS : ATLAS_SOLID,
+                      sprites ? white : SDL_Color{255, 215, 0, 255});
+    }
+    if (game.powerUpKind != POWER_NONE)
+    {
+        pushBoardRect(wall, g, {game.powerUp.x, game.powerUp.y, SNAKE_VELOCITY, SNAKE_VELOCITY},
+                      sprites ? ATLAS_SEGMENT : ATLAS_SOLID, powerUpColors[game.powerUpKind]);
+    }
+}
 
-            if (distance < bonusFoodRadius + snakeVelocity / 2)
+// Submits every quad of the wall: one SDL_RenderGeometry call, or straight
+// into the framebuffer on the raster backend
+void submitSpectatorQuads(SDL_Renderer *renderer, SpectatorWall &wall)
+{
+    const size_t count = wall.quads.size();
+    if (renderBackend == BACKEND_RASTER)
+    {
+        for (const SpectatorQuad &q : wall.quads)
+        {
+            int left = (int)floorf(q.x), top = (int)floorf(q.y);
+            SDL_Rect rect = {left, top, max(1, (int)floorf(q.x + q.w) - left), max(1, (int)floorf(q.y + q.h) - top)};
+            Uint32 color = 0xFF000000 | ((Uint32)q.color.b << 16) | ((Uint32)q.color.g << 8) | q.color.r;
+            if (q.sprite == ATLAS_SOLID)
+            {
+                rasterFillRect(frame, rect, color);
+            }
+            else if (q.sprite == ATLAS_SEGMENT)
+            {
+                rasterFillCircle(frame, (int)(q.x + q.w / 2), (int)(q.y + q.h / 2), max(1, (int)(q.w / 2)), color);
+            }
+            else
             {
-                Mix_PlayChannel(-1, bonusEatingSound, 0);
-                score += 10;
-                bonusFoodActive = false;
+                rasterBlit(frame, q.sprite == ATLAS_FOOD ? regularFoodImage.surface : bonusFoodImage.surface, &rect);
             }
         }
+        return;
+    }
 
-        SDL_SetRenderDrawColor(gameRenderer, 100, 150, 200, 255);
-        SDL_RenderClear(gameRenderer);
-
-        SDL_SetRenderDrawColor(gameRenderer, 180, 180, 180, 0);
-        SDL_Rect topWall = {0, 0, SCREEN_WIDTH, wallThickness + 2};
-        SDL_Rect bottomWall = {0, SCREEN_HEIGHT - wallThickness, SCREEN_WIDTH, wallThickness};
-        SDL_Rect leftWall = {0, 0, wallThickness, SCREEN_HEIGHT};
-        SDL_Rect rightWall = {SCREEN_WIDTH - wallThickness, 0, wallThickness, SCREEN_HEIGHT};
-        SDL_RenderFillRect(gameRenderer, &topWall);
-        SDL_RenderFillRect(gameRenderer, &bottomWall);
-        SDL_RenderFillRect(gameRenderer, &leftWall);
-        SDL_RenderFillRect(gameRenderer, &rightWall);
-
-        SDL_SetRenderDrawColor(gameRenderer, 0, 0, 0, 0);
-        SDL_Rect topObstracle = {610, 60, SCREEN_WIDTH / 3 - 150, wallThickness - 10};
-        SDL_Rect bottomObstracle = {60, SCREEN_HEIGHT - (wallThickness + 50), SCREEN_WIDTH - 700, wallThickness - 10};
-        SDL_Rect leftObstracle = {60, 60, wallThickness - 10, SCREEN_HEIGHT - 120};
-        SDL_Rect rightObstracle = {SCREEN_WIDTH - (wallThickness + 60), 60, wallThickness - 10, SCREEN_HEIGHT - 120};
-        SDL_RenderFillRect(gameRenderer, &topObstracle);
-        SDL_RenderFillRect(gameRenderer, &bottomObstracle);
-        SDL_RenderFillRect(gameRenderer, &leftObstracle);
-        SDL_RenderFillRect(gameRenderer, &rightObstracle);
+    if (count == 0)
+    {
+        return;
+    }
 
-        // Check for collision with obstacles
-        SDL_Rect newHeadRect = {newHead.x, newHead.y, snakeVelocity, snakeVelocity};
-        if (SDL_HasIntersection(&newHeadRect, &topObstracle) || SDL_HasIntersection(&newHeadRect, &bottomObstracle) ||
-            SDL_HasIntersection(&newHeadRect, &leftObstracle) || SDL_HasIntersection(&newHeadRect, &rightObstracle))
+    if (wall.vertices.size() < count * 4)
+    {
+        size_t from = wall.indices.size() / 6;
+        wall.vertices.resize(count * 4);
+        wall.indices.resize(count * 6);
+        for (size_t i = from; i < count; i++)
         {
-            bool paused = true;
-
-            SDL_Color red = {255, 0, 0, 255};
-            string pauseMessage = "WARNING!. Press Y to continue or N to quit.";
-
-            SDL_RenderPresent(gameRenderer);
-
-            while (paused)
+            const int quad[6] = {0, 1, 2, 2, 1, 3};
+            for (int k = 0; k < 6; k++)
             {
-                // Render the current game state (snake and obstacles)
-                SDL_SetRenderDrawColor(gameRenderer, 100, 150, 200, 255);
-                SDL_RenderClear(gameRenderer);
-
-                // Render obstacles
-                SDL_SetRenderDrawColor(gameRenderer, 0, 0, 0, 255);
-                SDL_RenderFillRect(gameRenderer, &topObstracle);
-                SDL_RenderFillRect(gameRenderer, &bottomObstracle);
-                SDL_RenderFillRect(gameRenderer, &leftObstracle);
-                SDL_RenderFillRect(gameRenderer, &rightObstracle);
-
-                // Render snake
-                for (size_t i = 0; i < snake.size(); i++)
-                {
-                    int colorIntensity = 200 - (int)(pow(i, 1.5) * 5);
-                    SDL_SetRenderDrawColor(gameRenderer, 0, colorIntensity, 0, 255);
-                    drawCircle(gameRenderer, snake[i].x + snakeVelocity / 2, snake[i].y + snakeVelocity / 2, snakeVelocity / 2);
-                }
-
-                renderText(gameRenderer, pauseMessage.c_str(), SCREEN_WIDTH / 2 - 320, SCREEN_HEIGHT / 2, red);
-
-                SDL_RenderPresent(gameRenderer);
-                while (SDL_PollEvent(&e))
-                {
-                    if (e.type == SDL_QUIT)
-                    {
-                        gameRunning = false;
-                        paused = false;
-                    }
-                    else if (e.type == SDL_KEYDOWN)
-                    {
-                        if (e.key.keysym.sym == SDLK_y)
-                        {
-                            paused = false;
-                        }
-                        else if (e.key.keysym.sym == SDLK_n)
-                        {
-                            paused = false;
-                            gameRunning = false;
-                            bool gameOver = true;
-
-                            SDL_Color orange = {255, 165, 0, 255};
-                            SDL_Cursor *arrowCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_ARROW);
-                            SDL_Cursor *handCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_HAND);
-
-                            SDL_SetCursor(arrowCursor);
-
-                            int buttonWidth = 200, buttonHeight = 50;
-                            int overX = SCREEN_WIDTH / 2 - 100;
-                            int overY = SCREEN_HEIGHT / 2 - 50;
-
-                            renderGameOverButton(gameRenderer, overX, overY, buttonWidth, buttonHeight, orange);
-                            SDL_RenderPresent(gameRenderer);
-
-                            while (gameOver)
-                            {
-                                while (SDL_PollEvent(&e))
-                                {
-                                    if (e.type == SDL_QUIT)
-                                    {
-                                        gameOver = false;
-                                    }
-                                    else if (e.type == SDL_MOUSEMOTION)
-                                    {
-                                        int mouseX = e.motion.x;
-                                        int mouseY = e.motion.y;
-
-                                        bool isOverButton = isMouseOverButton(mouseX, mouseY, overX, overY, buttonWidth, buttonHeight);
-                                        if (isOverButton)
-                                        {
-                                            SDL_SetCursor(handCursor);
-                                        }
-                                        else
-                                        {
-                                            SDL_SetCursor(arrowCursor);
-                                        }
-                                    }
-                                    else if (e.type == SDL_MOUSEBUTTONUP && e.button.button == SDL_BUTTON_LEFT)
-                                    {
-                                        int mouseX = e.button.x;
-                                        int mouseY = e.button.y;
-
-                                        if (handleGameOverButtonClick(mouseX, mouseY, overX, overY, buttonWidth, buttonHeight))
-                                        {
-                                            gameOver = false;
-                                            SDL_FreeCursor(arrowCursor);
-                                            SDL_FreeCursor(handCursor);
-
-                                            // Display the Game Over screen
-                                            displayGameOverScreen(gameRenderer, score);
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
+                wall.indices[i * 6 + k] = (int)(i * 4) + quad[k];
             }
         }
+    }
 
-        for (size_t i = 0; i < snake.size(); i++)
+    // The solid sprite samples the middle of its cell so filtering never
+    // reaches a neighbour
+    const float texel = 1.0f / (ATLAS_CELL * ATLAS_SPRITES);
+    for (size_t i = 0; i < count; i++)
+    {
+        const SpectatorQuad &q = wall.quads[i];
+        float u0 = (float)(q.sprite * ATLAS_CELL) * texel, u1 = u0 + ATLAS_CELL * texel, v0 = 0, v1 = 1;
+        if (q.sprite == ATLAS_SOLID)
         {
-            int colorIntensity = 200 - (int)(pow(i, 1.5) * 5);
-            int glowIntensity = colorIntensity + 30;
+            u0 = u1 = (ATLAS_CELL / 2.0f) * texel;
+            v0 = v1 = 0.5f;
+        }
+        SDL_Vertex *v = &wall.vertices[i * 4];
+        v[0] = {{q.x, q.y}, q.color, {u0, v0}};
+        v[1] = {{q.x + q.w, q.y}, q.color, {u1, v0}};
+        v[2] = {{q.x, q.y + q.h}, q.color, {u0, v1}};
+        v[3] = {{q.x + q.w, q.y + q.h}, q.color, {u1, v1}};
+    }
+    SDL_RenderGeometry(renderer, wall.atlas, wall.vertices.data(), (int)count * 4, wall.indices.data(), (int)count * 6);
+}
 
-            if (i == 0)
-            {
-                SDL_SetRenderDrawColor(gameRenderer, 0, glowIntensity, 0, 100);
-                drawCircle(gameRenderer, snake[i].x + snakeVelocity / 2, snake[i].y + snakeVelocity / 2, snakeVelocity / 2 + 2);
+void renderSpectatorWall(SDL_Renderer *renderer, SpectatorWall &wall)
+{
+    wall.quads.clear();
+    for (const SpectatorGame &g : wall.games)
+    {
+        collectSpectatorQuads(wall, g);
+    }
 
-                SDL_SetRenderDrawColor(gameRenderer, 128, 128, 128, 255);
-                drawCircle(gameRenderer, snake[i].x + snakeVelocity / 2, snake[i].y + snakeVelocity / 2, snakeVelocity / 2 + 1);
+    setDrawColor(renderer, 20, 20, 20, 255);
+    clearScreen(renderer);
+    submitSpectatorQuads(renderer, wall);
+}
 
-                SDL_SetRenderDrawColor(gameRenderer, 0, 255, 0, 255);
-                drawCircle(gameRenderer, snake[i].x + snakeVelocity / 2, snake[i].y + snakeVelocity / 2, snakeVelocity / 2);
+// The interactive wall: runs until the window closes or Escape, capped at
+// 60 fps, with the measured rate in the corner
+bool runSpectatorWall(SDL_Renderer *renderer, int count, const vector<const char *> &replayPaths)
+{
+    SpectatorWall wall;
+    if (levels.empty() || !setupSpectatorWall(wall, renderer, count, levels[currentLevel], replayPaths))
+    {
+        destroySpectatorWall(wall);
+        return false;
+    }
 
-                SDL_SetRenderDrawColor(gameRenderer, 0, 0, 0, 255);
-                SDL_RenderDrawPoint(gameRenderer, snake[i].x + snakeVelocity / 4, snake[i].y + snakeVelocity / 4);
-                SDL_RenderDrawPoint(gameRenderer, snake[i].x + (3 * snakeVelocity) / 4, snake[i].y + snakeVelocity / 4);
-            }
-            else
+    TextCache rateText;
+    char rate[64] = "";
+    long framesShown = 0;
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 last = SDL_GetPerformanceCounter(), rateStart = last;
+    bool running = true;
+    while (running)
+    {
+        SDL_Event e;
+        while (SDL_PollEvent(&e) != 0)
+        {
+            if (e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE))
             {
-                SDL_SetRenderDrawColor(gameRenderer, 0, glowIntensity, 0, 100);
-                drawCircle(gameRenderer, snake[i].x + snakeVelocity / 2, snake[i].y + snakeVelocity / 2, snakeVelocity / 2 + 2);
-
-                SDL_SetRenderDrawColor(gameRenderer, 128, 128, 128, 255);
-                drawCircle(gameRenderer, snake[i].x + snakeVelocity / 2, snake[i].y + snakeVelocity / 2, snakeVelocity / 2 + 1);
-
-                SDL_SetRenderDrawColor(gameRenderer, 0, colorIntensity, 0, 255);
-                drawCircle(gameRenderer, snake[i].x + snakeVelocity / 2, snake[i].y + snakeVelocity / 2, snakeVelocity / 2);
+                running = false;
             }
         }
 
-        SDL_Rect foodRect = {food.x, food.y, 15, 15};
-        SDL_RenderCopy(gameRenderer, regularFoodTexture, nullptr, &foodRect);
+        Uint64 frameStart = SDL_GetPerformanceCounter();
+        advanceSpectatorWall(wall, (frameStart - last) * 1000.0 / freq);
+        last = frameStart;
 
-        if (bonusFoodActive)
+        renderSpectatorWall(renderer, wall);
+        if (frameStart - rateStart >= freq)
         {
-            SDL_Rect bonusFoodRect = {bonusFood.x - bonusFoodRadius, bonusFood.y - bonusFoodRadius, 25, 25};
-            SDL_RenderCopy(gameRenderer, bonusFoodTexture, nullptr, &bonusFoodRect);
+            snprintf(rate, sizeof(rate), "%d games, %.1f fps", (int)wall.games.size(),
+                     framesShown * (double)freq / (frameStart - rateStart));
+            framesShown = 0;
+            rateStart = frameStart;
         }
+        if (rate[0] != '\0')
+        {
+            drawCachedText(renderer, rateText, score, rate, 4, 2, {255, 255, 255, 255});
+        }
+        presentFrame(renderer);
+        measureFrame(frameTimes, frameStart);
+        framesShown++;
 
-        SDL_Color black = {0, 0, 0, 255};
-        string scoreText = "Score: " + to_string(score);
-
-        int scoreX = 1;
-        int scoreY = 1;
-        scoreRenderText(gameRenderer, scoreText.c_str(), scoreX, scoreY, black);
-
-        SDL_RenderPresent(gameRenderer);
-
-        SDL_Delay(100);
+        double spentMs = (SDL_GetPerformanceCounter() - frameStart) * 1000.0 / freq;
+        if (spentMs < SPECTATOR_FRAME_MS)
+        {
+            SDL_Delay((Uint32)(SPECTATOR_FRAME_MS - spentMs));
+        }
     }
 
-    SDL_DestroyTexture(regularFoodTexture);
-    SDL_DestroyTexture(bonusFoodTexture);
-    SDL_DestroyRenderer(gameRenderer);
-    SDL_DestroyWindow(gameWindow);
+    if (frameTimes.frames > 0)
+    {
+        cout << "Spectator wall: " << wall.games.size() << " games, " << frameTimes.totalMs / frameTimes.frames
+             << " ms average frame, " << frameTimes.worstMs << " ms worst" << endl;
+    }
+    freeImage(rateText.image);
+    destroySpectatorWall(wall);
+    return true;
 }
 
-void GameLoop(SDL_Renderer *renderer)
+// Re-simulates a recorded replay with no frame pacing and streams every frame
+// to videoPath. Runs headless on the raster backend, so it is bounded by
+// simulation, rasterization and encoding only.
+bool renderReplay(SDL_Renderer *renderer, const char *replayPath, const char *videoPath)
 {
-    SDL_Event e;
-    bool quit = false;
-    bool gameStarted = false;
-
-    SDL_Color white = {255, 255, 255, 255};
-    SDL_Color black = {0, 0, 0, 255};
-
-    int buttonWidth = 200, buttonHeight = 50;
-    int startX = SCREEN_WIDTH / 2 - 100;
-    int startY = SCREEN_HEIGHT / 2 - 50;
-
-    int exitX = SCREEN_WIDTH / 2 - 100;
-    int exitY = SCREEN_HEIGHT / 2 + 50;
-
-    SDL_Cursor *arrowCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_ARROW);
-    SDL_Cursor *handCursor = SDL_CreateSystemCursor(SDL_SYSTEM_CURSOR_HAND);
-
-    SDL_SetCursor(arrowCursor);
-
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
-
-    loadAndRenderImage(renderer, "image/cover_photo.png");
-
-    renderStartButton(renderer, startX, startY, buttonWidth, buttonHeight, black);
-    renderExitButton(renderer, exitX, exitY, buttonWidth, buttonHeight, white);
+    ReplayReader reader;
+    if (!openReplay(reader, replayPath) || !startCapture(videoPath, true))
+    {
+        return false;
+    }
 
-    SDL_RenderPresent(renderer);
+    GameState game;
+    long ticks = 0;
+    Uint64 start = SDL_GetPerformanceCounter();
 
-    while (!quit)
+    for (ReplayStep step = readReplay(reader, game); step != REPLAY_STEP_END; step = readReplay(reader, game))
     {
-        while (SDL_PollEvent(&e) != 0)
+        if (step == REPLAY_STEP_ERROR)
         {
-            if (e.type == SDL_QUIT)
-            {
-                quit = true;
-            }
-            else if (e.type == SDL_MOUSEMOTION)
-            {
-                int mouseX = e.motion.x;
-                int mouseY = e.motion.y;
+            stopCapture();
+            return false;
+        }
 
-                bool overStartButton = isMouseOverButton(mouseX, mouseY, startX, startY, buttonWidth, buttonHeight);
-                bool overExitButton = isMouseOverButton(mouseX, mouseY, exitX, exitY, buttonWidth, buttonHeight);
+        if (step == REPLAY_STEP_GAME_START)
+        {
+            clearParticles(particles);
+        }
+        else
+        {
+            TickResult result = tickGame(game);
+            emitTickEffects(particles, game, result);
+            updateParticles(particles, CAPTURE_FRAME_MS / 1000.0f);
+            ticks++;
 
-                if (overStartButton || overExitButton)
-                {
-                    SDL_SetCursor(handCursor);
-                }
-                else
-                {
-                    SDL_SetCursor(arrowCursor);
-                }
-            }
-            else if (e.type == SDL_MOUSEBUTTONUP && e.button.button == SDL_BUTTON_LEFT)
+            if (result.collision == COLLISION_WALL || result.collision == COLLISION_SELF)
             {
-                int mouseX = e.button.x;
-                int mouseY = e.button.y;
-
-                if (handleStartButtonClick(mouseX, mouseY, startX, startY, buttonWidth, buttonHeight))
-                {
-                    gameStarted = true;
-                    quit = true;
-                }
-                else if (handleExitButtonClick(mouseX, mouseY, exitX, exitY, buttonWidth, buttonHeight))
-                {
-                    quit = true;
-                }
+                renderGameOver(renderer, game);
+                presentFrame(renderer);
+                capture.offlineMs += tickDelayMs(game);
+                dirty.valid = false;
+                reader.playing = false;
+                continue;
             }
         }
+
+        renderPlaying(renderer, game);
+        presentFrame(renderer);
+        capture.offlineMs += tickDelayMs(game);
     }
 
-    SDL_FreeCursor(arrowCursor);
-    SDL_FreeCursor(handCursor);
+    stopCapture();
+    reportDirtyRects();
 
-    if (gameStarted)
-    {
-        GameStarted(renderer);
-    }
+    double seconds = (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+    cout << "Rendered " << ticks << " ticks in " << seconds << " s ("
+         << (seconds > 0 ? capture.offlineMs / 1000.0 / seconds : 0.0) << "x real time)" << endl;
+    return true;
 }
 
 void cleanUp(SDL_Window *window, SDL_Renderer *renderer)
@@ -947,38 +5360,48 @@ void cleanUp(SDL_Window *window, SDL_Renderer *renderer)
     TTF_CloseFont(font);
     font = nullptr;
 
-    SDL_DestroyRenderer(renderer);
-    SDL_DestroyWindow(window);
+    TTF_CloseFont(score);
+    score = nullptr;
 
-    Mix_Quit();
-    TTF_Quit();
-    IMG_Quit();
-    SDL_Quit();
-}
+    TTF_CloseFont(finalScore);
+    finalScore = nullptr;
 
-int main(int argc, char *args[])
-{
-    if (!initializeSDL(window, renderer))
-    {
-        cleanUp(window, renderer);
-        return -1;
-    }
+    TTF_CloseFont(game_over);
+    game_over = nullptr;
 
-    if (!loadAndRenderImage(renderer, "image/cover_photo.png"))
-    {
-        cleanUp(window, renderer);
-        return -1;
-    }
+    freeImage(coverImage);
+    freeImage(gameOverScreenImage);
+    freeImage(regularFoodImage);
+    freeImage(bonusFoodImage);
+    freeImage(scoreText.image);
+    scoreText.font = nullptr;
 
-    if (!playBackgroundMusic("audio/background_music.mp3"))
+    SDL_FreeSurface(frame.surface);
+    frame.surface = nullptr;
+
+    SDL_DestroyTexture(dirtyTarget);
+    dirtyTarget = nullptr;
+
+    for (Level &level : levels)
     {
-        cleanUp(window, renderer);
-        return -1;
+        freeLevel(level);
     }
+    levels.clear();
+
+    // Fonts, sounds, music and raster images above may point into the bundle
+    unmapAssets();
+
+    SDL_FreeCursor(arrowCursor);
+    arrowCursor = nullptr;
 
-    GameLoop(renderer);
+    SDL_FreeCursor(handCursor);
+    handCursor = nullptr;
 
-    cleanUp(window, renderer);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
 
-    return 0;
+    Mix_Quit();
+    TTF_Quit();
+    IMG_Quit();
+    SDL_Quit();
 }
@@ -0,0 +1,859 @@
+#ifndef SNAKE_H
+#define SNAKE_H
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <SDL2/SDL_mixer.h>
+#include <SDL2/SDL_ttf.h>
+#include <bits/stdc++.h>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void renderText(SDL_Renderer *renderer, const char *message, int x, int y, SDL_Color color);
+void renderStartButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor);
+void renderExitButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor);
+void renderGameOverButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor);
+void renderRestartButton(SDL_Renderer *renderer, int x, int y, int width, int height, SDL_Color textColor);
+void drawCircle(SDL_Renderer *renderer, int centerX, int centerY, int radius);
+void buildParticleIndices();
+void runScenes(SDL_Renderer *renderer);
+void cleanUp(SDL_Window *window, SDL_Renderer *renderer);
+
+extern SDL_Window *window;
+extern SDL_Renderer *renderer;
+extern Mix_Music *backgroundMusic;
+extern TTF_Font *font;
+extern TTF_Font *score;
+extern TTF_Font *finalScore;
+extern TTF_Font *game_over;
+extern Mix_Chunk *eatingSound;
+extern Mix_Chunk *bonusEatingSound;
+extern Mix_Chunk *gameOverSound;
+extern SDL_Cursor *arrowCursor;
+extern SDL_Cursor *handCursor;
+extern Uint32 rendererFlags;
+
+const int SCREEN_WIDTH = 800;
+const int SCREEN_HEIGHT = 600;
+const int WALL_THICKNESS = 20;
+const int SNAKE_VELOCITY = 10;
+
+const int AUDIO_FREQUENCY = 44100;
+const int AUDIO_CHANNELS = 2;
+const int AUDIO_BUFFER_SAMPLES = 2048;
+const int BONUS_FOOD_RADIUS = 10;
+
+// Timed rules, in ticks, and the tick interval at each speed
+const Uint32 BONUS_FOOD_TICKS = 60;
+const Uint32 POWER_UP_INTERVAL = 150;
+const Uint32 POWER_UP_TICKS = 80;
+const Uint32 SPEED_TICKS = 50;
+const Uint32 OBSTACLES_UP_TICKS = 300;
+const Uint32 OBSTACLES_DOWN_TICKS = 80;
+const Uint32 TICK_MS = 100;
+const Uint32 FAST_TICK_MS = 60;
+const Uint32 SLOW_TICK_MS = 160;
+
+const SDL_Rect menuStartButton = {SCREEN_WIDTH / 2 - 100, SCREEN_HEIGHT / 2 - 50, 200, 50};
+const SDL_Rect menuExitButton = {SCREEN_WIDTH / 2 - 100, SCREEN_HEIGHT / 2 + 50, 200, 50};
+const SDL_Rect gameOverButton = {SCREEN_WIDTH / 2 - 100, SCREEN_HEIGHT / 2 - 50, 200, 50};
+const SDL_Rect restartButton = {SCREEN_WIDTH / 2 - 120, SCREEN_HEIGHT / 2 + 70, 240, 50};
+const SDL_Rect finalExitButton = {SCREEN_WIDTH / 2 - 100, SCREEN_HEIGHT / 2 + 150, 200, 50};
+
+struct SnakeSegment
+{
+    int x, y;
+};
+
+enum Scene
+{
+    SCENE_MENU,
+    SCENE_PLAYING,
+    SCENE_PAUSED,
+    SCENE_GAME_OVER,
+    SCENE_FINAL_SCORE,
+    SCENE_QUIT
+};
+
+enum Collision
+{
+    COLLISION_NONE,
+    COLLISION_WALL,
+    COLLISION_SELF,
+    COLLISION_OBSTACLE
+};
+
+// Compiled level ("SNKL"), laid out so a mapped file is used in place: this
+// header, the spawn points, the wall and obstacle rects, then a bitmap of
+// wall cells and one of obstacle cells (one bit per SNAKE_VELOCITY cell,
+// rowBytes per row). Native little-endian, every section 8-byte aligned.
+const Uint32 LEVEL_VERSION = 1;
+const int LEVEL_NAME_LENGTH = 32;
+
+struct LevelSpawn
+{
+    Sint32 x, y;
+    Sint32 dirX, dirY;
+};
+
+struct LevelHeader
+{
+    char magic[4];
+    Uint32 version;
+    char name[LEVEL_NAME_LENGTH];
+    Sint32 width, height; // board in pixels
+    Sint32 cols, rows;    // board in cells
+    Uint32 rowBytes;
+    SDL_Rect field; // area food spawns in
+    Uint32 spawnCount, wallCount, obstacleCount;
+    Uint32 spawnOffset, wallOffset, obstacleOffset, wallBitsOffset, obstacleBitsOffset;
+    Uint32 fileSize;
+};
+
+// A loaded level: pointers into either a read-only file mapping or data.
+struct Level
+{
+    const LevelHeader *header = nullptr;
+    const LevelSpawn *spawns = nullptr;
+    const SDL_Rect *walls = nullptr;
+    const SDL_Rect *obstacles = nullptr;
+    const Uint8 *wallBits = nullptr;
+    const Uint8 *obstacleBits = nullptr;
+    void *mapping = nullptr;
+    size_t mappingSize = 0;
+    std::vector<Uint64> data; // compiled in memory instead of mapped
+};
+
+// Timed events run on a hierarchical timer wheel counted in simulation
+// ticks: TIMER_WHEEL_LEVELS rings of TIMER_WHEEL_SLOTS slots, level n
+// holding timers due within 64^(n+1) ticks. Timers are pooled and linked
+// into their slot both ways, so scheduling and cancelling are O(1); a ring
+// above level 0 is redistributed downwards once per 64^n ticks.
+const int TIMER_WHEEL_BITS = 6;
+const int TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_BITS;
+const int TIMER_WHEEL_LEVELS = 4;
+const Uint32 TIMER_MAX_DELAY = (1u << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+
+enum TimerKind
+{
+    TIMER_BONUS_EXPIRE,
+    TIMER_POWER_UP_SPAWN,
+    TIMER_POWER_UP_EXPIRE,
+    TIMER_SPEED_END,
+    TIMER_OBSTACLES
+};
+
+// 0 is never a valid id: the low 20 bits are the pool index plus one and
+// the high 12 a generation, so a stale id cannot cancel a reused timer
+typedef Uint32 TimerId;
+
+struct Timer
+{
+    Uint32 expires;
+    Uint16 kind;
+    Uint16 generation;
+    Sint32 data;
+    Sint32 prev, next; // slot list, or next free while unused
+    Sint32 slot;       // -1 while unused
+};
+
+struct TimerWheel
+{
+    Uint32 now = 0;
+    std::vector<Timer> timers;
+    Sint32 freeList = -1;
+    Sint32 slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+    int active = 0;
+};
+
+// Optional rules for a game, all driven by its timer wheel. Replays store
+// the set a game was played with; older replays play with none.
+enum Rule
+{
+    RULE_BONUS_EXPIRY = 1, // bonus food disappears after BONUS_FOOD_TICKS
+    RULE_POWER_UPS = 2,    // speed-up, slow-down and shrink pickups
+    RULE_OBSTACLE_CYCLE = 4, // obstacles periodically drop for a while
+    RULES_CLASSIC = 0,
+    RULES_ALL = 7
+};
+
+enum PowerUp
+{
+    POWER_NONE,
+    POWER_SPEED_UP,
+    POWER_SLOW_DOWN,
+    POWER_SHRINK,
+    POWER_KINDS
+};
+
+// The snake, head first, in a power-of-two ring: moving is O(1) at any
+// length, and once reserved for a full board growing never reallocates
+struct SnakeBody
+{
+    std::vector<SnakeSegment> cells;
+    size_t start = 0; // the head's index in cells
+    size_t length = 0;
+
+    size_t size() const
+    {
+        return length;
+    }
+    size_t capacity() const
+    {
+        return cells.size();
+    }
+    SnakeSegment &operator[](size_t i)
+    {
+        return cells[(start + i) & (cells.size() - 1)];
+    }
+    const SnakeSegment &operator[](size_t i) const
+    {
+        return cells[(start + i) & (cells.size() - 1)];
+    }
+    const SnakeSegment &front() const
+    {
+        return (*this)[0];
+    }
+    const SnakeSegment &back() const
+    {
+        return (*this)[length - 1];
+    }
+
+    // Keeps the segments, unwrapped to start at cells[0]
+    void reserve(size_t n)
+    {
+        if (n <= cells.size())
+        {
+            return;
+        }
+        size_t size = 1;
+        while (size < n)
+        {
+            size *= 2;
+        }
+        std::vector<SnakeSegment> grown(size);
+        for (size_t i = 0; i < length; i++)
+        {
+            grown[i] = (*this)[i];
+        }
+        cells.swap(grown);
+        start = 0;
+    }
+    void clear()
+    {
+        start = 0;
+        length = 0;
+    }
+    void pushHead(SnakeSegment segment)
+    {
+        reserve(length + 1);
+        start = (start - 1) & (cells.size() - 1);
+        cells[start] = segment;
+        length++;
+    }
+    void pushTail(SnakeSegment segment)
+    {
+        reserve(length + 1);
+        length++;
+        (*this)[length - 1] = segment;
+    }
+    void popTail()
+    {
+        length--;
+    }
+    // Drops segments from the tail down to n
+    void truncate(size_t n)
+    {
+        length = std::min(length, n);
+    }
+    // Copies only the live segments, so a reserved copy does not allocate
+    void copyFrom(const SnakeBody &other)
+    {
+        reserve(other.length);
+        start = 0;
+        length = other.length;
+        for (size_t i = 0; i < length; i++)
+        {
+            cells[i] = other[i];
+        }
+    }
+};
+
+struct GameState
+{
+    SnakeBody snake;
+    int dirX, dirY;
+    SDL_Rect food;
+    bool bonusFoodActive;
+    SDL_Point bonusFood;
+    int score;
+    int foodCount;
+    const Level *level;
+    Uint32 rngState; // per-game xorshift32 so a seed replays the same food
+
+    Uint32 rules;
+    TimerWheel timers;
+    TimerId bonusTimer;
+    Uint32 bonusExpires; // tick the bonus disappears at, 0 if it stays
+    PowerUp powerUpKind; // POWER_NONE while no pickup is on the field
+    SDL_Point powerUp;
+    TimerId powerUpTimer;
+    PowerUp speed; // POWER_NONE at normal speed
+    TimerId speedTimer;
+    bool obstaclesDown;
+};
+
+struct TickResult
+{
+    Collision collision;
+    bool ateFood;
+    bool ateBonus;
+    bool spawnedBonus;
+    PowerUp powerUp; // pickup taken this tick
+    bool bonusExpired;
+    bool obstaclesChanged;
+};
+
+enum RenderBackend
+{
+    BACKEND_SDL,
+    BACKEND_RASTER
+};
+
+// Target of the raster backend. Pixels are SDL_PIXELFORMAT_RGBA32 (R, G, B, A
+// bytes in memory, so 0xAABBGGRR on little-endian) and always kept opaque.
+struct Framebuffer
+{
+    int width = 0, height = 0;
+    std::vector<Uint32> pixels;
+    std::vector<Uint32> row; // scratch row for scaled blits
+    SDL_Rect clip = {0, 0, 0, 0};
+    Uint32 color = 0xFF000000;
+    SDL_Surface *surface = nullptr; // wraps pixels for presenting to the window
+};
+
+// A picture drawable by either backend: a texture for SDL_Renderer, an RGBA32
+// surface for the raster backend.
+struct Image
+{
+    SDL_Texture *texture = nullptr;
+    SDL_Surface *surface = nullptr;
+};
+
+extern RenderBackend renderBackend;
+extern bool dirtyRectMode;
+extern SDL_Point drawOrigin; // added to every position drawn; the board's origin on screen while it is drawn
+extern bool standInText; // fixed glyph boxes instead of TTF output, for golden frames
+extern Uint64 launchCounter; // start of loading, until the first menu frame is reported
+extern Uint32 gameRules; // for games started from the menu
+extern SDL_Texture *dirtyTarget; // persistent playfield for dirty rects on SDL_Renderer
+extern Framebuffer frame;
+extern Image coverImage;
+extern Image gameOverScreenImage;
+extern Image regularFoodImage;
+extern Image bonusFoodImage;
+
+// Telemetry. emitTelemetry appends a fixed-size event to the calling
+// thread's ring, which only that thread writes and only the flush thread
+// reads, so an event costs a counter read and a few stores and never blocks
+// or allocates; a full ring counts the event as dropped instead. The flush
+// thread drains every ring in batches to NDJSON (.ndjson/.jsonl paths) or
+// packed binary records, starting a new file past the size limit and
+// keeping TELEMETRY_KEEP_FILES old ones as <path>.1, <path>.2, ... It holds
+// the registry lock only to list the rings and free those whose threads
+// have exited, never while writing. A ring lives until its thread exits
+// and the flush thread has drained it.
+enum TelemetryType
+{
+    TELEMETRY_GAME_START,  // a: level index, b: seed
+    TELEMETRY_TICK,        // a: snake length, b: tickGame time in ns
+    TELEMETRY_EAT,         // a: score, b: snake length
+    TELEMETRY_BONUS_SPAWN, // a, b: bonus position
+    TELEMETRY_BONUS_EAT,   // a: score
+    TELEMETRY_COLLISION,   // a: Collision, b: score
+    TELEMETRY_RESTART,     // a: score of the finished game
+    TELEMETRY_QUIT,        // a: Scene quit from, b: score
+    TELEMETRY_TYPE_COUNT
+};
+
+struct TelemetryEvent
+{
+    Uint64 time; // SDL_GetPerformanceCounter
+    Uint16 type;
+    Uint16 thread;
+    Sint32 a;
+    Sint64 b;
+};
+
+struct TelemetryRing
+{
+    static const unsigned CAPACITY = 16384; // power of two
+    TelemetryEvent events[CAPACITY];
+    alignas(64) std::atomic<unsigned> head{0}; // flush thread's side
+    alignas(64) std::atomic<unsigned> tail{0}; // emitting thread's side
+    std::atomic<Uint64> dropped{0};
+    std::atomic<bool> retired{false}; // its thread has exited; nothing more will be emitted
+    Uint16 thread = 0;
+};
+
+// Allocation accounting, built in with -DSNAKE_ALLOC_STATS. operator
+// new/delete are then replaced and SDL's allocator (which SDL_image,
+// SDL_mixer and SDL_ttf go through) is hooked, so every allocation made that
+// way is counted, with its size, against the subsystem the allocating thread
+// is in. Other builds keep the default allocators and count nothing. Code
+// marks its subsystem with an AllocationScope; anything unmarked, including
+// other threads, is "other".
+// Plain malloc inside third-party libraries (FreeType, libpng) is not seen.
+// Counts run from one endAllocationFrame to the next; --alloc-log writes
+// every frame as a CSV row and F3 shows the last frame over the game.
+enum AllocationSubsystem
+{
+    ALLOC_OTHER,
+    ALLOC_SIMULATION,
+    ALLOC_EFFECTS,
+    ALLOC_RENDER,
+    ALLOC_TEXT,
+    ALLOC_AUDIO,
+    ALLOC_OVERLAY,
+    ALLOC_SUBSYSTEMS
+};
+
+struct AllocationFrame
+{
+    Uint64 count[ALLOC_SUBSYSTEMS] = {};
+    Uint64 bytes[ALLOC_SUBSYSTEMS] = {};
+    Uint64 totalCount = 0, totalBytes = 0;
+};
+
+#if defined(SNAKE_ALLOC_STATS)
+const bool allocationCounting = true;
+#else
+const bool allocationCounting = false;
+#endif
+
+extern thread_local AllocationSubsystem allocationSubsystem;
+
+// Attributes allocations on this thread to subsystem until it goes out of scope
+struct AllocationScope
+{
+    AllocationSubsystem previous;
+
+    explicit AllocationScope(AllocationSubsystem subsystem) : previous(allocationSubsystem)
+    {
+        allocationSubsystem = subsystem;
+    }
+    ~AllocationScope()
+    {
+        allocationSubsystem = previous;
+    }
+};
+
+// Levels. A level source (levels/*.lvl) is text, one directive per line and
+// '#' starting a comment:
+//   name <id>                 shown in the menu and stored in replays
+//   size <w> <h>              board in pixels, multiples of SNAKE_VELOCITY
+//   field <x> <y> <w> <h>     area food spawns in, default the whole board
+//   wall|obstacle <x> <y> <w> <h>
+//   spawn <x> <y> right|left|up|down
+//   map                       then one line per cell row: '#' wall,
+//                             'X' obstacle, '@' spawn facing right
+// A wall covers the cells whose centre it contains and ends the game; an
+// obstacle covers every cell it touches and pauses it. compileLevel turns a
+// source into the SNKL image, which the game maps instead of parsing.
+struct LevelSource
+{
+    std::string name;
+    int width = SCREEN_WIDTH, height = SCREEN_HEIGHT;
+    SDL_Rect field = {0, 0, 0, 0};
+    std::vector<SDL_Rect> walls, obstacles;
+    std::vector<LevelSpawn> spawns;
+    std::vector<std::string> map;
+};
+
+const Uint32 ASSET_BUNDLE_VERSION = 1;
+
+const int ASSET_NAME_LENGTH = 48;
+
+const size_t ASSET_ALIGNMENT = 64;
+
+enum AssetType
+{
+    ASSET_FONT,
+    ASSET_SOUND,
+    ASSET_MUSIC,
+    ASSET_IMAGE
+};
+
+struct AssetBundleHeader
+{
+    char magic[4];
+    Uint32 version;
+    Uint32 count;
+    Sint32 audioFrequency;
+    Uint16 audioFormat;
+    Uint16 audioChannels;
+    Uint32 reserved;
+    Uint64 fileSize;
+};
+
+struct AssetEntry
+{
+    char name[ASSET_NAME_LENGTH];
+    Uint32 type;
+    Sint32 width, height; // images only; rows are width * 4 bytes
+    Uint32 reserved;
+    Uint64 offset, size;
+};
+
+struct AssetFile
+{
+    const char *path;
+    AssetType type;
+};
+
+const AssetFile assetFiles[] = {
+    {"Fonts/arial.ttf", ASSET_FONT},
+    {"Fonts/score.otf", ASSET_FONT},
+    {"Fonts/game_over.ttf", ASSET_FONT},
+    {"Fonts/finalScore.otf", ASSET_FONT},
+    {"audio/eating_sound.wav", ASSET_SOUND},
+    {"audio/bonus_eating_sound.mp3", ASSET_SOUND},
+    {"audio/game_over_sound.wav", ASSET_SOUND},
+    {"audio/background_music.mp3", ASSET_MUSIC},
+    {"image/cover_photo.png", ASSET_IMAGE},
+    {"image/game_over_screen.png", ASSET_IMAGE},
+    {"image/normal_fruit.png", ASSET_IMAGE},
+    {"image/bonus_fruit.png", ASSET_IMAGE}};
+
+// A line of text kept rendered between frames and redrawn from the cache
+// until its message changes, so a steady HUD skips TTF and texture creation
+struct TextCache
+{
+    char message[64] = "";
+    TTF_Font *font = nullptr;
+    SDL_Color color = {0, 0, 0, 0};
+    Image image;
+    int width = 0, height = 0;
+};
+
+// Environments: a batch of independent games for training agents, stepped
+// together by stepEnvBatch. Each step writes ENV_PLANES observation planes,
+// the score gained and a done flag per game into caller-owned buffers, and
+// resets finished games in place. Any collision ends an episode.
+enum EnvAction
+{
+    ENV_KEEP, // keep the current direction
+    ENV_UP,
+    ENV_DOWN,
+    ENV_LEFT,
+    ENV_RIGHT
+};
+
+enum EnvPlane
+{
+    ENV_PLANE_BODY, // every segment, head included
+    ENV_PLANE_HEAD,
+    ENV_PLANE_FOOD,
+    ENV_PLANE_BONUS,     // cells the head eats the bonus from
+    ENV_PLANE_POWER_UP,  // the pickup's cell, set to its PowerUp kind
+    ENV_PLANE_OBSTACLES, // walls, and obstacles while they are up
+    ENV_PLANES
+};
+
+struct EnvBatch
+{
+    const Level *level = nullptr;
+    Uint32 rules = RULES_CLASSIC;
+    int count = 0;
+    int cols = 0, rows = 0;
+    size_t planeSize = 0; // cols * rows
+    std::vector<GameState> games;
+    std::vector<Uint32> seeds; // per-game state the next episode's seed comes from
+    std::vector<Uint8> obstaclePlane;
+    std::vector<Uint8> wallPlane; // the obstacle plane while obstacles are down
+
+    Uint8 *observations = nullptr; // count * ENV_PLANES * planeSize
+    float *rewards = nullptr;      // count
+    Uint8 *dones = nullptr;        // count
+    const Uint8 *actions = nullptr;
+
+    std::vector<std::thread> workers;
+    int shardSize = 0;
+    std::atomic<Uint32> generation{0};
+    std::atomic<int> finished{0};
+    std::atomic<bool> stopping{false};
+};
+
+const int PARTICLE_CAPACITY = 1 << 16;
+
+struct ParticlePool
+{
+    int count = 0;
+    Uint32 rngState = 0x2545F491; // separate from the game's, so replays are unaffected
+    Uint64 lastUpdate = 0;
+    alignas(32) float x[PARTICLE_CAPACITY];
+    alignas(32) float y[PARTICLE_CAPACITY];
+    alignas(32) float vx[PARTICLE_CAPACITY];
+    alignas(32) float vy[PARTICLE_CAPACITY];
+    alignas(32) float life[PARTICLE_CAPACITY]; // seconds left
+    alignas(32) float fade[PARTICLE_CAPACITY]; // 1 / starting life
+    Uint32 color[PARTICLE_CAPACITY];           // RGBA32, alpha comes from life
+};
+
+// Palettes in the framebuffer's RGBA32 layout (0xAABBGGRR)
+const Uint32 eatPalette[] = {0xFF30E0F0, 0xFF20C8A0, 0xFF40FF80};
+const Uint32 bonusPalette[] = {0xFFF040E0, 0xFF20C0FF, 0xFFFFFFFF, 0xFFC060FF};
+const Uint32 deathPalette[] = {0xFF00C800, 0xFF808080, 0xFF2030E0, 0xFF00FF00};
+
+struct DirtyRects
+{
+    bool valid = false;
+    SDL_Point origin = {0, 0}; // board origin on screen; board damage is offset by it
+    SnakeBody snake; // the state last drawn
+    SDL_Rect food;
+    bool bonusFoodActive;
+    SDL_Rect bonusFood; // with its countdown bar
+    PowerUp powerUpKind;
+    SDL_Rect powerUp;
+    bool obstaclesDown;
+    int score;
+    std::vector<SDL_Rect> particles; // particle bounds last drawn, unless there were too many
+    bool particlesOverflow;
+    std::vector<SDL_Rect> regions;
+    long frames = 0;
+    long fullRedraws = 0;
+    long long pixels = 0;
+};
+
+// How far each tick started from one tick interval after the previous one
+struct TickJitter
+{
+    Uint64 last = 0; // counter at the previous tick, 0 at the start of a run
+    Uint32 intervalMs = 0;
+    long ticks = 0;
+    double totalMs = 0, worstMs = 0;
+};
+
+struct FrameTimes
+{
+    long frames = 0;
+    double totalMs = 0, worstMs = 0;
+};
+
+// Pipelined play: eats, bonuses, pickups and collisions the simulation sent
+// this game and the SDL thread played
+struct PipelineEvents
+{
+    Uint64 sent = 0;
+    Uint64 played = 0;
+    Uint64 batched = 0; // frames that played more than one tick's events
+};
+
+// Recordings are read one step at a time, so a replay can be rendered to
+// video or played back alongside other games
+struct ReplayReader
+{
+    std::vector<Uint8> data;
+    size_t position = 5;
+    bool playing = false; // inside a game, where direction bytes are ticks
+};
+
+const double SPECTATOR_FRAME_MS = 1000.0 / 60;
+
+enum AtlasSprite
+{
+    ATLAS_SOLID,
+    ATLAS_SEGMENT,
+    ATLAS_FOOD,
+    ATLAS_BONUS,
+    ATLAS_SPRITES
+};
+
+enum SpectatorDetail
+{
+    DETAIL_SPRITES,
+    DETAIL_CELLS,
+    DETAIL_PIXELS
+};
+
+struct SpectatorQuad
+{
+    float x, y, w, h;
+    AtlasSprite sprite;
+    SDL_Color color;
+};
+
+struct SpectatorGame
+{
+    GameState game;
+    bool replayed = false;
+    ReplayReader replay;
+    bool stopped = false; // a recording with nothing left to play
+    Uint32 seed = 0;
+    double dueMs = 0;
+    SDL_Rect cell = {0, 0, 0, 0}; // viewport
+    float originX = 0, originY = 0, scale = 1;
+    SpectatorDetail detail = DETAIL_SPRITES;
+};
+
+struct SpectatorWall
+{
+    std::vector<SpectatorGame> games;
+    const Level *level = nullptr; // live games play this
+    std::vector<SpectatorQuad> quads;
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+    SDL_Texture *atlas = nullptr;
+    double nowMs = 0;
+};
+
+extern std::vector<Level> levels;
+extern size_t currentLevel;
+extern std::string levelsDirectory;
+extern std::string assetBundlePath;
+extern TextCache scoreText;
+extern ParticlePool particles;
+extern DirtyRects dirty;
+extern TickJitter tickJitter; // written by whichever thread runs the simulation
+extern FrameTimes frameTimes;
+extern PipelineEvents pipelineEvents; // read only while the simulation is parked
+extern bool pipelinedMode;
+extern bool autopilot;
+extern Uint32 slowRenderMs; // added to every playing frame to stand in for a slow present
+
+void resizeFramebuffer(Framebuffer &fb, int width, int height);
+void rasterFillRect(Framebuffer &fb, const SDL_Rect &rect, Uint32 color);
+void rasterFillCircle(Framebuffer &fb, int centerX, int centerY, int radius, Uint32 color);
+void rasterBlit(Framebuffer &fb, const SDL_Surface *image, const SDL_Rect *dst);
+bool startCapture(const char *path, bool offline);
+void stopCapture();
+void emitTelemetry(TelemetryType type, Sint32 a = 0, Sint64 b = 0);
+bool startTelemetry(const char *path, long long rotateBytes);
+void stopTelemetry();
+void hookAllocator();
+bool startAllocationLog(const char *path);
+const AllocationFrame &endAllocationFrame(const char *label);
+void resetAllocationFrame();
+void stopAllocationLog();
+void reportAllocations();
+bool parseLevelSource(LevelSource &source, const std::string &path);
+bool compileLevel(const LevelSource &source, std::vector<Uint64> &image);
+bool bindLevel(Level &level, const Uint8 *bytes, size_t size, const std::string &origin);
+bool buildLevel(Level &level, const LevelSource &source);
+bool writeLevel(const std::vector<Uint64> &image, const std::string &path);
+void freeLevel(Level &level);
+bool mapLevel(Level &level, const std::string &path);
+int findLevel(const char *name);
+bool compileLevels(const std::string &dir, bool onlyStale);
+bool loadLevels(const std::string &dir);
+bool startRecording(const char *path);
+void stopRecording();
+void presentFrame(SDL_Renderer *renderer);
+bool mapAssets(const std::string &path);
+void evictAssetsFromCache();
+void freeImage(Image &image);
+bool initializeSDL(SDL_Window *&window, SDL_Renderer *&renderer);
+void scoreRenderText(SDL_Renderer *renderer, const char *message, int x, int y, SDL_Color color);
+bool playBackgroundMusic(const char *musicPath);
+void linkTimer(TimerWheel &wheel, Sint32 index);
+void unlinkTimer(TimerWheel &wheel, Sint32 index);
+void releaseTimer(TimerWheel &wheel, Sint32 index);
+void clearTimers(TimerWheel &wheel);
+TimerId scheduleTimer(TimerWheel &wheel, Uint32 delay, TimerKind kind, Sint32 data = 0);
+bool cancelTimer(TimerWheel &wheel, TimerId id);
+bool hitsWall(const Level &level, SnakeSegment head);
+bool hitsSelf(const SnakeBody &snake, SnakeSegment head);
+bool hitsObstacle(const GameState &game, SnakeSegment head);
+void spawnFood(GameState &game);
+void spawnBonusFood(GameState &game);
+void resetGame(GameState &game, const Level &level, Uint32 seed, Uint32 rules, bool reserveBoard = true);
+void steerSnake(GameState &game, SDL_Keycode key);
+TickResult tickGame(GameState &game);
+SDL_Keycode autopilotKey(const GameState &game);
+bool createEnvBatch(EnvBatch &batch, const Level &level, int count, Uint32 seed, Uint32 rules, int threads,
+                    Uint8 *observations, float *rewards, Uint8 *dones);
+void stepEnvBatch(EnvBatch &batch, const Uint8 *actions);
+void destroyEnvBatch(EnvBatch &batch);
+void emitParticles(ParticlePool &pool, float x, float y, int count, float minSpeed, float maxSpeed, float life,
+                   const Uint32 *palette, int paletteSize);
+void emitTickEffects(ParticlePool &pool, const GameState &game, const TickResult &result);
+void updateParticles(ParticlePool &pool, float dt);
+void advanceParticles(ParticlePool &pool);
+void clearParticles(ParticlePool &pool);
+void renderParticles(SDL_Renderer *renderer, const ParticlePool &pool);
+void renderSnake(SDL_Renderer *renderer, const SnakeBody &snake, const SDL_Rect *region = nullptr);
+void renderGame(SDL_Renderer *renderer, const GameState &game);
+void renderGameDirty(SDL_Renderer *renderer, const GameState &game);
+void renderPlaying(SDL_Renderer *renderer, const GameState &game);
+void reportDirtyRects();
+void renderMenu(SDL_Renderer *renderer);
+void renderPaused(SDL_Renderer *renderer, const GameState &game);
+void renderGameOver(SDL_Renderer *renderer, const GameState &game);
+void renderFinalScore(SDL_Renderer *renderer, const GameState &game);
+void reportPlayTiming();
+void stopSimulation();
+void shutdownSimulation();
+Uint32 sceneDelayMs(Scene scene, const GameState &game);
+Scene playingScene(SDL_Renderer *renderer, GameState &game);
+Scene pipelinedPlayingScene(SDL_Renderer *renderer, GameState &game);
+void spectatorWallSize(SDL_Renderer *renderer, int &width, int &height);
+int spectatorCapacity(int width, int height);
+void destroySpectatorWall(SpectatorWall &wall);
+bool setupSpectatorWall(SpectatorWall &wall, SDL_Renderer *renderer, int count, const Level &level,
+                        const std::vector<const char *> &replayPaths);
+void advanceSpectatorWall(SpectatorWall &wall, double elapsedMs);
+void renderSpectatorWall(SDL_Renderer *renderer, SpectatorWall &wall);
+bool runSpectatorWall(SDL_Renderer *renderer, int count, const std::vector<const char *> &replayPaths);
+bool renderReplay(SDL_Renderer *renderer, const char *replayPath, const char *videoPath);
+
+// Moves the wheel one tick on and calls fire(timer) for each timer due.
+// A timer is released before it fires, so fire may schedule and cancel.
+template <typename Fire>
+void advanceTimers(TimerWheel &wheel, Fire fire)
+{
+    wheel.now++;
+    for (int level = TIMER_WHEEL_LEVELS - 1; level >= 1; level--)
+    {
+        if ((wheel.now & ((1u << (TIMER_WHEEL_BITS * level)) - 1)) != 0)
+        {
+            continue;
+        }
+
+        Sint32 &slot = wheel.slots[level * TIMER_WHEEL_SLOTS + ((wheel.now >> (TIMER_WHEEL_BITS * level)) & (TIMER_WHEEL_SLOTS - 1))];
+        Sint32 index = slot;
+        slot = -1;
+        while (index >= 0)
+        {
+            Sint32 next = wheel.timers[index].next;
+            linkTimer(wheel, index);
+            index = next;
+        }
+    }
+
+    Sint32 &slot = wheel.slots[wheel.now & (TIMER_WHEEL_SLOTS - 1)];
+    while (slot >= 0)
+    {
+        Sint32 index = slot;
+        Timer timer = wheel.timers[index];
+        unlinkTimer(wheel, index);
+        releaseTimer(wheel, index);
+        fire(timer);
+    }
+}
+
+#endif